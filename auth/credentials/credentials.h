@@ -267,6 +267,8 @@ bool cli_credentials_parse_password_fd(struct cli_credentials *credentials,
 				       int fd, enum credentials_obtained obtained);
 void cli_credentials_invalidate_ccache(struct cli_credentials *cred,
 				       enum credentials_obtained obtained);
+void cli_credentials_forget_service_ticket(struct cli_credentials *cred,
+					   const char *server_principal);
 void cli_credentials_set_salt_principal(struct cli_credentials *cred, const char *principal);
 void cli_credentials_set_impersonate_principal(struct cli_credentials *cred,
 					       const char *principal,
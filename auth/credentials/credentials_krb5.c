@@ -34,6 +34,11 @@
 #include "auth/kerberos/pac_utils.h"
 #include "param/param.h"
 #include "../libds/common/flags.h"
+#include "lib/util/dlinklist.h"
+
+#ifdef HAVE_PTHREAD
+#include "system/threads.h"
+#endif
 
 #undef DBGC_CLASS
 #define DBGC_CLASS DBGC_AUTH
@@ -56,6 +61,297 @@ static int free_mccache(struct ccache_container *ccc)
 	return 0;
 }
 
+/*
+ * Process-wide cache of service tickets, keyed by client and server
+ * principal. Tickets are collected from private memory ccaches when
+ * they are freed and copied into new ones right after the kinit, for
+ * the same client principal only. A reconnect to the same service
+ * then reuses the ticket instead of sending another TGS-REQ. The
+ * kinit proves the new ccache belongs to that client, so no ticket
+ * is handed to anybody who could not have asked the KDC for it.
+ *
+ * The library is also used by multi-threaded programs, all access to
+ * the cache goes through service_ticket_cache_lock().
+ */
+struct cli_credentials_service_ticket {
+	struct cli_credentials_service_ticket *prev, *next;
+	krb5_creds *creds;
+};
+
+static struct {
+	krb5_context context;
+	struct cli_credentials_service_ticket *tickets;
+	size_t num_tickets;
+	size_t max_tickets;
+} service_ticket_cache;
+
+#ifdef HAVE_PTHREAD
+static pthread_mutex_t service_ticket_cache_mutex = PTHREAD_MUTEX_INITIALIZER;
+#endif
+
+static void service_ticket_cache_lock(void)
+{
+#ifdef HAVE_PTHREAD
+	int ret = pthread_mutex_lock(&service_ticket_cache_mutex);
+	if (ret != 0) {
+		smb_panic("service_ticket_cache_lock failed");
+	}
+#endif
+}
+
+static void service_ticket_cache_unlock(void)
+{
+#ifdef HAVE_PTHREAD
+	int ret = pthread_mutex_unlock(&service_ticket_cache_mutex);
+	if (ret != 0) {
+		smb_panic("service_ticket_cache_unlock failed");
+	}
+#endif
+}
+
+/*
+ * Don't hand out tickets that expire within this many seconds, same
+ * as the refresh threshold in cli_credentials_get_named_ccache()
+ */
+#define SERVICE_TICKET_MIN_LIFETIME 300
+
+static int service_ticket_destructor(struct cli_credentials_service_ticket *t)
+{
+	DLIST_REMOVE(service_ticket_cache.tickets, t);
+	service_ticket_cache.num_tickets -= 1;
+	krb5_free_creds(service_ticket_cache.context, t->creds);
+	return 0;
+}
+
+static void service_ticket_cache_add(krb5_creds *creds)
+{
+	struct cli_credentials_service_ticket *t = NULL, *next = NULL;
+	krb5_error_code code;
+	time_t now = time(NULL);
+
+	for (t = service_ticket_cache.tickets; t != NULL; t = next) {
+		next = t->next;
+
+		if ((t->creds->times.endtime <= now) ||
+		    (krb5_principal_compare(service_ticket_cache.context,
+					    t->creds->client,
+					    creds->client) &&
+		     krb5_principal_compare(service_ticket_cache.context,
+					    t->creds->server,
+					    creds->server))) {
+			TALLOC_FREE(t);
+		}
+	}
+
+	while ((service_ticket_cache.num_tickets >=
+		service_ticket_cache.max_tickets) &&
+	       (service_ticket_cache.tickets != NULL)) {
+		t = DLIST_TAIL(service_ticket_cache.tickets);
+		TALLOC_FREE(t);
+	}
+
+	t = talloc_zero(NULL, struct cli_credentials_service_ticket);
+	if (t == NULL) {
+		return;
+	}
+	code = krb5_copy_creds(service_ticket_cache.context, creds, &t->creds);
+	if (code != 0) {
+		TALLOC_FREE(t);
+		return;
+	}
+	DLIST_ADD(service_ticket_cache.tickets, t);
+	service_ticket_cache.num_tickets += 1;
+	talloc_set_destructor(t, service_ticket_destructor);
+}
+
+static bool service_ticket_cacheable(krb5_context context,
+				     const krb5_creds *creds)
+{
+	if (krb5_is_config_principal(context, creds->server)) {
+		return false;
+	}
+	if (smb_krb5_principal_is_tgs(context, creds->server) != 0) {
+		return false;
+	}
+	return creds->times.endtime > time(NULL) + SERVICE_TICKET_MIN_LIFETIME;
+}
+
+/* Remember the service tickets in a private ccache that is going away */
+static void service_ticket_cache_collect(krb5_context context,
+					 krb5_ccache ccache)
+{
+	krb5_cc_cursor cursor;
+	krb5_creds creds;
+	krb5_error_code code;
+
+	service_ticket_cache_lock();
+
+	if ((service_ticket_cache.context == NULL) ||
+	    (service_ticket_cache.max_tickets == 0)) {
+		goto done;
+	}
+
+	code = krb5_cc_start_seq_get(context, ccache, &cursor);
+	if (code != 0) {
+		goto done;
+	}
+	while (krb5_cc_next_cred(context, ccache, &cursor, &creds) == 0) {
+		if (service_ticket_cacheable(context, &creds)) {
+			service_ticket_cache_add(&creds);
+		}
+		krb5_free_cred_contents(context, &creds);
+	}
+	krb5_cc_end_seq_get(context, ccache, &cursor);
+
+done:
+	service_ticket_cache_unlock();
+}
+
+/* Copy the still valid tickets of the ccache's client into it */
+static void service_ticket_cache_seed(krb5_context context,
+				      krb5_ccache ccache,
+				      int max_tickets)
+{
+	struct cli_credentials_service_ticket *t = NULL;
+	krb5_principal client = NULL;
+	krb5_error_code code;
+	time_t now = time(NULL);
+
+	service_ticket_cache_lock();
+
+	service_ticket_cache.max_tickets = MAX(max_tickets, 0);
+	if (service_ticket_cache.max_tickets == 0) {
+		while (service_ticket_cache.tickets != NULL) {
+			t = service_ticket_cache.tickets;
+			TALLOC_FREE(t);
+		}
+		goto done;
+	}
+
+	if (service_ticket_cache.context == NULL) {
+		code = krb5_init_context(&service_ticket_cache.context);
+		if (code != 0) {
+			service_ticket_cache.context = NULL;
+			goto done;
+		}
+	}
+
+	code = krb5_cc_get_principal(context, ccache, &client);
+	if (code != 0) {
+		goto done;
+	}
+
+	for (t = service_ticket_cache.tickets; t != NULL; t = t->next) {
+		if (t->creds->times.endtime <=
+		    now + SERVICE_TICKET_MIN_LIFETIME) {
+			continue;
+		}
+		if (!krb5_principal_compare(context, t->creds->client, client)) {
+			continue;
+		}
+		code = krb5_cc_store_cred(context, ccache, t->creds);
+		if (code != 0) {
+			DBG_DEBUG("krb5_cc_store_cred failed: %s\n",
+				  error_message(code));
+		}
+	}
+
+	krb5_free_principal(context, client);
+
+done:
+	service_ticket_cache_unlock();
+}
+
+/*
+ * Drop the cached tickets of client, for server only or all of them
+ * if server is NULL. The realm of server is not compared, callers
+ * usually only know the service and host name.
+ */
+static void service_ticket_cache_drop(krb5_context context,
+				      krb5_const_principal client,
+				      krb5_const_principal server)
+{
+	struct cli_credentials_service_ticket *t = NULL, *next = NULL;
+
+	service_ticket_cache_lock();
+
+	for (t = service_ticket_cache.tickets; t != NULL; t = next) {
+		next = t->next;
+
+		if (!krb5_principal_compare(context, t->creds->client, client)) {
+			continue;
+		}
+		if ((server != NULL) &&
+		    !krb5_principal_compare_any_realm(context,
+						      t->creds->server,
+						      server)) {
+			continue;
+		}
+		TALLOC_FREE(t);
+	}
+
+	service_ticket_cache_unlock();
+}
+
+/*
+ * The ccache is invalid or holds a ticket the server rejected: drop
+ * the client's tickets and don't collect them again when it is freed
+ */
+static void service_ticket_cache_forget_ccache(struct ccache_container *ccc,
+					       krb5_const_principal server)
+{
+	krb5_context context = NULL;
+	krb5_principal client = NULL;
+	krb5_error_code code;
+
+	if ((ccc == NULL) || !ccc->share_service_tickets) {
+		return;
+	}
+	ccc->share_service_tickets = false;
+
+	context = ccc->smb_krb5_context->krb5_context;
+
+	code = krb5_cc_get_principal(context, ccc->ccache, &client);
+	if (code != 0) {
+		return;
+	}
+	service_ticket_cache_drop(context, client, server);
+	krb5_free_principal(context, client);
+}
+
+/* Free a private memory ccache, keeping its service tickets */
+static int free_shared_mccache(struct ccache_container *ccc)
+{
+	if ((ccc->ccache != NULL) && ccc->share_service_tickets) {
+		service_ticket_cache_collect(
+			ccc->smb_krb5_context->krb5_context, ccc->ccache);
+	}
+	return free_mccache(ccc);
+}
+
+/*
+ * Only private memory ccaches that hold the client's own tickets
+ * share service tickets, not named or FILE ccaches, nor ones obtained
+ * via S4U2Self for somebody else.
+ */
+static bool cli_credentials_shares_service_tickets(
+					struct cli_credentials *cred,
+					struct loadparm_context *lp_ctx,
+					const char *ccache_name)
+{
+	if (ccache_name != NULL) {
+		return false;
+	}
+	if (cred->impersonate_principal != NULL) {
+		return false;
+	}
+	if (lpcfg_parm_bool(lp_ctx, NULL, "credentials", "krb5_cc_file",
+			    false)) {
+		return false;
+	}
+	return true;
+}
+
 /* Free a disk-based ccache */
 static int free_dccache(struct ccache_container *ccc)
 {
@@ -293,7 +589,7 @@ _PUBLIC_ int cli_credentials_set_ccache(struct cli_credentials *cred,
 		return 0;
 	}
 
-	ccc = talloc(cred, struct ccache_container);
+	ccc = talloc_zero(cred, struct ccache_container);
 	if (!ccc) {
 		(*error_string) = error_message(ENOMEM);
 		return ENOMEM;
@@ -587,7 +883,7 @@ static int cli_credentials_new_ccache(struct cli_credentials *cred,
 	char *ccache_name = given_ccache_name;
 	bool must_free_cc_name = false;
 	krb5_error_code ret;
-	struct ccache_container *ccc = talloc(cred, struct ccache_container);
+	struct ccache_container *ccc = talloc_zero(cred, struct ccache_container);
 	if (!ccc) {
 		return ENOMEM;
 	}
@@ -723,6 +1019,16 @@ _PUBLIC_ int cli_credentials_get_named_ccache(struct cli_credentials *cred,
 		return ret;
 	}
 
+	if (cli_credentials_shares_service_tickets(cred, lp_ctx, ccache_name)) {
+		service_ticket_cache_seed(
+			(*ccc)->smb_krb5_context->krb5_context,
+			(*ccc)->ccache,
+			lpcfg_parm_int(lp_ctx, NULL, "credentials",
+				       "service ticket cache size", 128));
+		(*ccc)->share_service_tickets = true;
+		talloc_set_destructor(*ccc, free_shared_mccache);
+	}
+
 	ret = cli_credentials_set_from_ccache(cred, *ccc,
 					      obtained, error_string);
 
@@ -868,6 +1174,7 @@ void cli_credentials_invalidate_client_gss_creds(struct cli_credentials *cred,
 static void cli_credentials_unconditionally_invalidate_ccache(struct cli_credentials *cred)
 {
 	if (cred->ccache_obtained > CRED_UNINITIALISED) {
+		service_ticket_cache_forget_ccache(cred->ccache, NULL);
 		talloc_unlink(cred, cred->ccache);
 		cred->ccache = NULL;
 	}
@@ -883,6 +1190,7 @@ _PUBLIC_ void cli_credentials_invalidate_ccache(struct cli_credentials *cred,
 	 * any cached credentials are now invalid */
 	if (obtained >= cred->ccache_obtained) {
 		if (cred->ccache_obtained > CRED_UNINITIALISED) {
+			service_ticket_cache_forget_ccache(cred->ccache, NULL);
 			talloc_unlink(cred, cred->ccache);
 			cred->ccache = NULL;
 		}
@@ -900,6 +1208,37 @@ _PUBLIC_ void cli_credentials_invalidate_ccache(struct cli_credentials *cred,
 						    obtained);
 }
 
+/*
+ * The server rejected our ticket for server_principal, e.g. with
+ * KRB5KRB_AP_ERR_MODIFIED or KRB5KRB_AP_ERR_BADKEYVER after its key
+ * changed. Make sure the ticket is not handed out again by the
+ * process-wide service ticket cache.
+ */
+_PUBLIC_ void cli_credentials_forget_service_ticket(struct cli_credentials *cred,
+						    const char *server_principal)
+{
+	krb5_context context = NULL;
+	krb5_principal server = NULL;
+	krb5_error_code code;
+
+	if ((cred->ccache_obtained == CRED_UNINITIALISED) ||
+	    (cred->ccache == NULL) ||
+	    !cred->ccache->share_service_tickets) {
+		return;
+	}
+	context = cred->ccache->smb_krb5_context->krb5_context;
+
+	code = krb5_parse_name(context, server_principal, &server);
+	if (code != 0) {
+		/* Drop all of the client's tickets */
+		server = NULL;
+	}
+	service_ticket_cache_forget_ccache(cred->ccache, server);
+	if (server != NULL) {
+		krb5_free_principal(context, server);
+	}
+}
+
 static int free_gssapi_creds(struct gssapi_creds_container *gcc)
 {
 	OM_uint32 min_stat;
@@ -1170,7 +1509,7 @@ static int cli_credentials_shallow_ccache(struct cli_credentials *cred)
 	}
 	krb5_free_principal(old_ccc->smb_krb5_context->krb5_context, princ);
 
-	ccc = talloc(cred, struct ccache_container);
+	ccc = talloc_zero(cred, struct ccache_container);
 	if (ccc == NULL) {
 		return ENOMEM;
 	}
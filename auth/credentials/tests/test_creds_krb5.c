@@ -0,0 +1,324 @@
+/*
+ * Unix SMB/CIFS implementation.
+ *
+ * Tests for the process-wide service ticket cache
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <stdarg.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <setjmp.h>
+#include <cmocka.h>
+
+#include "lib/replace/replace.h"
+#include "auth/credentials/credentials_krb5.c"
+
+#define CLIENT_PRINCIPAL "user@SAMBA.EXAMPLE.COM"
+#define SERVER1_PRINCIPAL "cifs/srv1.samba.example.com@SAMBA.EXAMPLE.COM"
+#define SERVER2_PRINCIPAL "cifs/srv2.samba.example.com@SAMBA.EXAMPLE.COM"
+
+struct test_state {
+	struct loadparm_context *lp_ctx;
+	struct smb_krb5_context *smb_krb5_context;
+	krb5_principal client;
+	krb5_principal server1;
+	krb5_principal server2;
+};
+
+static int setup_service_ticket_cache(void **state)
+{
+	struct test_state *s = NULL;
+	krb5_context context = NULL;
+	krb5_error_code code;
+
+	s = talloc_zero(NULL, struct test_state);
+	assert_non_null(s);
+
+	s->lp_ctx = loadparm_init_global(true);
+	assert_non_null(s->lp_ctx);
+
+	code = smb_krb5_init_context(s, s->lp_ctx, &s->smb_krb5_context);
+	assert_int_equal(code, 0);
+	context = s->smb_krb5_context->krb5_context;
+
+	code = krb5_parse_name(context, CLIENT_PRINCIPAL, &s->client);
+	assert_int_equal(code, 0);
+	code = krb5_parse_name(context, SERVER1_PRINCIPAL, &s->server1);
+	assert_int_equal(code, 0);
+	code = krb5_parse_name(context, SERVER2_PRINCIPAL, &s->server2);
+	assert_int_equal(code, 0);
+
+	/* Start every test with an empty cache */
+	service_ticket_cache_seed(NULL, NULL, 0);
+
+	*state = s;
+	return 0;
+}
+
+static int teardown_service_ticket_cache(void **state)
+{
+	struct test_state *s = *state;
+	krb5_context context = s->smb_krb5_context->krb5_context;
+
+	service_ticket_cache_seed(NULL, NULL, 0);
+
+	krb5_free_principal(context, s->client);
+	krb5_free_principal(context, s->server1);
+	krb5_free_principal(context, s->server2);
+	TALLOC_FREE(s);
+	return 0;
+}
+
+/*
+ * What cli_credentials_get_named_ccache() does for a private memory
+ * ccache after a successful kinit
+ */
+static struct ccache_container *new_shared_ccache(TALLOC_CTX *mem_ctx,
+						  struct test_state *s)
+{
+	krb5_context context = s->smb_krb5_context->krb5_context;
+	struct ccache_container *ccc = NULL;
+	krb5_error_code code;
+
+	ccc = talloc_zero(mem_ctx, struct ccache_container);
+	assert_non_null(ccc);
+	ccc->smb_krb5_context = s->smb_krb5_context;
+
+	code = smb_krb5_cc_new_unique_memory(context, NULL, NULL,
+					     &ccc->ccache);
+	assert_int_equal(code, 0);
+	talloc_set_destructor(ccc, free_mccache);
+
+	code = krb5_cc_initialize(context, ccc->ccache, s->client);
+	assert_int_equal(code, 0);
+
+	service_ticket_cache_seed(context, ccc->ccache, 128);
+	ccc->share_service_tickets = true;
+	talloc_set_destructor(ccc, free_shared_mccache);
+
+	return ccc;
+}
+
+/* What a TGS-REQ would store into the ccache */
+static void store_ticket(struct test_state *s,
+			 struct ccache_container *ccc,
+			 krb5_principal server)
+{
+	krb5_context context = s->smb_krb5_context->krb5_context;
+	char ticket[] = "ticket";
+	krb5_creds creds = {};
+	krb5_error_code code;
+
+	creds.client = s->client;
+	creds.server = server;
+	creds.times.authtime = time(NULL);
+	creds.times.starttime = creds.times.authtime;
+	creds.times.endtime = creds.times.authtime + 3600;
+	creds.ticket.data = ticket;
+	creds.ticket.length = sizeof(ticket);
+
+	code = krb5_cc_store_cred(context, ccc->ccache, &creds);
+	assert_int_equal(code, 0);
+}
+
+static bool has_ticket(struct test_state *s,
+		       struct ccache_container *ccc,
+		       krb5_principal server)
+{
+	krb5_context context = s->smb_krb5_context->krb5_context;
+	krb5_cc_cursor cursor;
+	krb5_creds creds;
+	krb5_error_code code;
+	bool found = false;
+
+	code = krb5_cc_start_seq_get(context, ccc->ccache, &cursor);
+	assert_int_equal(code, 0);
+	while (krb5_cc_next_cred(context, ccc->ccache, &cursor, &creds) == 0) {
+		if (krb5_principal_compare(context, creds.server, server)) {
+			found = true;
+		}
+		krb5_free_cred_contents(context, &creds);
+	}
+	krb5_cc_end_seq_get(context, ccc->ccache, &cursor);
+
+	return found;
+}
+
+static struct cli_credentials *creds_with_ccache(struct test_state *s,
+						 struct ccache_container *ccc)
+{
+	struct cli_credentials *cred = NULL;
+	bool ok;
+
+	cred = cli_credentials_init(s);
+	assert_non_null(cred);
+
+	ok = cli_credentials_set_principal(cred, CLIENT_PRINCIPAL,
+					   CRED_SPECIFIED);
+	assert_true(ok);
+
+	cred->ccache = talloc_steal(cred, ccc);
+	cred->ccache_obtained = CRED_SPECIFIED;
+
+	return cred;
+}
+
+static void torture_service_ticket_reconnect(void **state)
+{
+	struct test_state *s = *state;
+	struct ccache_container *ccc = NULL;
+
+	ccc = new_shared_ccache(s, s);
+	assert_false(has_ticket(s, ccc, s->server1));
+	store_ticket(s, ccc, s->server1);
+	TALLOC_FREE(ccc);
+
+	/* The reconnect finds the ticket of the first connection */
+	ccc = new_shared_ccache(s, s);
+	assert_true(has_ticket(s, ccc, s->server1));
+	assert_false(has_ticket(s, ccc, s->server2));
+	TALLOC_FREE(ccc);
+}
+
+static void torture_service_ticket_invalidate(void **state)
+{
+	struct test_state *s = *state;
+	struct ccache_container *ccc = NULL;
+	struct cli_credentials *cred = NULL;
+
+	ccc = new_shared_ccache(s, s);
+	store_ticket(s, ccc, s->server1);
+	TALLOC_FREE(ccc);
+
+	ccc = new_shared_ccache(s, s);
+	assert_true(has_ticket(s, ccc, s->server1));
+	store_ticket(s, ccc, s->server2);
+
+	cred = creds_with_ccache(s, ccc);
+	cli_credentials_invalidate_ccache(cred, CRED_SPECIFIED);
+	assert_null(cred->ccache);
+	TALLOC_FREE(cred);
+
+	/* Neither the older nor the invalidated tickets are reused */
+	ccc = new_shared_ccache(s, s);
+	assert_false(has_ticket(s, ccc, s->server1));
+	assert_false(has_ticket(s, ccc, s->server2));
+	TALLOC_FREE(ccc);
+}
+
+static void torture_service_ticket_password_change(void **state)
+{
+	struct test_state *s = *state;
+	struct ccache_container *ccc = NULL;
+	struct cli_credentials *cred = NULL;
+	bool ok;
+
+	ccc = new_shared_ccache(s, s);
+	store_ticket(s, ccc, s->server1);
+
+	cred = creds_with_ccache(s, ccc);
+	ok = cli_credentials_set_password(cred, "NEW-SECRET", CRED_SPECIFIED);
+	assert_true(ok);
+	assert_null(cred->ccache);
+	TALLOC_FREE(cred);
+
+	ccc = new_shared_ccache(s, s);
+	assert_false(has_ticket(s, ccc, s->server1));
+	TALLOC_FREE(ccc);
+}
+
+static void torture_service_ticket_forget(void **state)
+{
+	struct test_state *s = *state;
+	struct ccache_container *ccc = NULL;
+	struct cli_credentials *cred = NULL;
+
+	ccc = new_shared_ccache(s, s);
+	store_ticket(s, ccc, s->server1);
+	store_ticket(s, ccc, s->server2);
+	TALLOC_FREE(ccc);
+
+	ccc = new_shared_ccache(s, s);
+	assert_true(has_ticket(s, ccc, s->server1));
+	assert_true(has_ticket(s, ccc, s->server2));
+
+	/* srv1 rejected the AP-REQ, e.g. with KRB5KRB_AP_ERR_MODIFIED */
+	cred = creds_with_ccache(s, ccc);
+	cli_credentials_forget_service_ticket(cred, SERVER1_PRINCIPAL);
+	TALLOC_FREE(cred);
+
+	ccc = new_shared_ccache(s, s);
+	assert_false(has_ticket(s, ccc, s->server1));
+	assert_true(has_ticket(s, ccc, s->server2));
+	TALLOC_FREE(ccc);
+}
+
+static void torture_service_ticket_excluded(void **state)
+{
+	struct test_state *s = *state;
+	struct cli_credentials *cred = NULL;
+	bool ok;
+
+	cred = cli_credentials_init(s);
+	assert_non_null(cred);
+
+	ok = cli_credentials_shares_service_tickets(cred, s->lp_ctx, NULL);
+	assert_true(ok);
+
+	ok = cli_credentials_shares_service_tickets(cred,
+						    s->lp_ctx,
+						    "MEMORY:named");
+	assert_false(ok);
+
+	cli_credentials_set_impersonate_principal(cred,
+						  CLIENT_PRINCIPAL,
+						  SERVER1_PRINCIPAL);
+	ok = cli_credentials_shares_service_tickets(cred, s->lp_ctx, NULL);
+	assert_false(ok);
+
+	TALLOC_FREE(cred);
+}
+
+int main(int argc, char *argv[])
+{
+	int rc;
+	const struct CMUnitTest tests[] = {
+		cmocka_unit_test_setup_teardown(torture_service_ticket_reconnect,
+						setup_service_ticket_cache,
+						teardown_service_ticket_cache),
+		cmocka_unit_test_setup_teardown(torture_service_ticket_invalidate,
+						setup_service_ticket_cache,
+						teardown_service_ticket_cache),
+		cmocka_unit_test_setup_teardown(torture_service_ticket_password_change,
+						setup_service_ticket_cache,
+						teardown_service_ticket_cache),
+		cmocka_unit_test_setup_teardown(torture_service_ticket_forget,
+						setup_service_ticket_cache,
+						teardown_service_ticket_cache),
+		cmocka_unit_test_setup_teardown(torture_service_ticket_excluded,
+						setup_service_ticket_cache,
+						teardown_service_ticket_cache),
+	};
+
+	if (argc == 2) {
+		cmocka_set_test_filter(argv[1]);
+	}
+	cmocka_set_message_output(CM_OUTPUT_SUBUNIT);
+
+	rc = cmocka_run_group_tests(tests, NULL, NULL);
+
+	return rc;
+}
@@ -947,6 +947,48 @@ static int ldb_kv_msg_delete_attribute(struct ldb_module *module,
 	return LDB_SUCCESS;
 }
 
+/*
+  replace the values of an existing element, updating only the index
+  entries of the values that are added or removed
+*/
+static int ldb_kv_msg_replace_element(struct ldb_module *module,
+				      struct ldb_kv_private *ldb_kv,
+				      struct ldb_message *msg,
+				      struct ldb_message_element *old_el,
+				      struct ldb_message_element *el)
+{
+	int ret;
+
+	if (!ldb_dn_is_special(msg->dn) &&
+	    ldb_kv->cache->GUID_index_attribute != NULL &&
+	    ldb_attr_cmp(el->name, ldb_kv->cache->GUID_index_attribute) == 0) {
+		struct ldb_context *ldb = ldb_module_get_ctx(module);
+		ldb_asprintf_errstring(ldb,
+				       "Must not modify GUID "
+				       "attribute %s (used as DB index)",
+				       ldb_kv->cache->GUID_index_attribute);
+		return LDB_ERR_CONSTRAINT_VIOLATION;
+	}
+
+	ret = ldb_kv_index_replace_element(module, ldb_kv, msg, old_el, el);
+	if (ret != LDB_SUCCESS) {
+		return ret;
+	}
+
+	/* keep the element order the same as a delete and re-add */
+	talloc_free(old_el->values);
+	ldb_msg_remove_element(msg, old_el);
+	msg->elements = talloc_realloc(msg, msg->elements,
+				       struct ldb_message_element,
+				       msg->num_elements);
+
+	if (ldb_kv_msg_add_element(msg, el) != 0) {
+		return LDB_ERR_OPERATIONS_ERROR;
+	}
+
+	return LDB_SUCCESS;
+}
+
 /*
   delete all elements matching an attribute name/value
 
@@ -1254,12 +1296,17 @@ int ldb_kv_modify_internal(struct ldb_module *module,
 					continue;
 				}
 
-				/* Delete the attribute if it exists in the DB */
-				if (ldb_kv_msg_delete_attribute(
-					module, ldb_kv, msg2, el->name) != 0) {
+				/*
+				 * Swap in the new values, only
+				 * touching the index entries for the
+				 * values that change
+				 */
+				if (ldb_kv_msg_replace_element(
+					module, ldb_kv, msg2, el2, el) != 0) {
 					ret = LDB_ERR_OTHER;
 					goto done;
 				}
+				break;
 			}
 
 			/* Recreate it with the new values */
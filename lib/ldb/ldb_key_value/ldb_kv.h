@@ -272,6 +272,11 @@ int ldb_kv_index_del_value(struct ldb_module *module,
 			   const struct ldb_message *msg,
 			   struct ldb_message_element *el,
 			   unsigned int v_idx);
+int ldb_kv_index_replace_element(struct ldb_module *module,
+				 struct ldb_kv_private *ldb_kv,
+				 const struct ldb_message *msg,
+				 struct ldb_message_element *old_el,
+				 struct ldb_message_element *new_el);
 int ldb_kv_reindex(struct ldb_module *module);
 int ldb_kv_repack(struct ldb_module *module);
 int ldb_kv_index_transaction_start(
@@ -3401,6 +3401,120 @@ int ldb_kv_index_del_element(struct ldb_module *module,
 	return LDB_SUCCESS;
 }
 
+static int ldb_kv_val_ptr_cmp(const struct ldb_val * const *v1,
+			      const struct ldb_val * const *v2)
+{
+	if ((*v1)->length != (*v2)->length) {
+		return NUMERIC_CMP((*v1)->length, (*v2)->length);
+	}
+	return memcmp((*v1)->data, (*v2)->data, (*v1)->length);
+}
+
+/*
+  update the index entries for an element whose values are being
+  replaced by those of new_el.
+
+  Only the values that are actually removed or added have their index
+  records changed, values present (byte for byte) in both elements are
+  left alone. For a large multi-valued attribute, such as the member
+  attribute of a big group, this avoids rewriting every index record
+  when a single value changes.
+*/
+int ldb_kv_index_replace_element(struct ldb_module *module,
+				 struct ldb_kv_private *ldb_kv,
+				 const struct ldb_message *msg,
+				 struct ldb_message_element *old_el,
+				 struct ldb_message_element *new_el)
+{
+	const struct ldb_val **old_vals = NULL;
+	const struct ldb_val **new_vals = NULL;
+	bool *old_kept = NULL;
+	bool *new_kept = NULL;
+	TALLOC_CTX *tmp_ctx = NULL;
+	unsigned int i, j;
+	int ret;
+
+	if (!ldb_kv->cache->attribute_indexes) {
+		return LDB_SUCCESS;
+	}
+
+	if (ldb_dn_is_special(msg->dn)) {
+		return LDB_SUCCESS;
+	}
+
+	if (!ldb_kv_is_indexed(module, ldb_kv, old_el->name)) {
+		return LDB_SUCCESS;
+	}
+
+	tmp_ctx = talloc_new(module);
+	if (tmp_ctx == NULL) {
+		return ldb_module_oom(module);
+	}
+
+	old_vals = talloc_array(tmp_ctx, const struct ldb_val *,
+				old_el->num_values);
+	old_kept = talloc_zero_array(tmp_ctx, bool, old_el->num_values);
+	new_vals = talloc_array(tmp_ctx, const struct ldb_val *,
+				new_el->num_values);
+	new_kept = talloc_zero_array(tmp_ctx, bool, new_el->num_values);
+	if ((old_el->num_values > 0 && (old_vals == NULL || old_kept == NULL)) ||
+	    (new_el->num_values > 0 && (new_vals == NULL || new_kept == NULL))) {
+		talloc_free(tmp_ctx);
+		return ldb_module_oom(module);
+	}
+
+	for (i = 0; i < old_el->num_values; i++) {
+		old_vals[i] = &old_el->values[i];
+	}
+	for (i = 0; i < new_el->num_values; i++) {
+		new_vals[i] = &new_el->values[i];
+	}
+	TYPESAFE_QSORT(old_vals, old_el->num_values, ldb_kv_val_ptr_cmp);
+	TYPESAFE_QSORT(new_vals, new_el->num_values, ldb_kv_val_ptr_cmp);
+
+	/* find the values present in both elements */
+	i = 0;
+	j = 0;
+	while (i < old_el->num_values && j < new_el->num_values) {
+		int cmp = ldb_kv_val_ptr_cmp(&old_vals[i], &new_vals[j]);
+		if (cmp < 0) {
+			i++;
+		} else if (cmp > 0) {
+			j++;
+		} else {
+			old_kept[old_vals[i] - old_el->values] = true;
+			new_kept[new_vals[j] - new_el->values] = true;
+			i++;
+			j++;
+		}
+	}
+
+	for (i = 0; i < old_el->num_values; i++) {
+		if (old_kept[i]) {
+			continue;
+		}
+		ret = ldb_kv_index_del_value(module, ldb_kv, msg, old_el, i);
+		if (ret != LDB_SUCCESS) {
+			talloc_free(tmp_ctx);
+			return ret;
+		}
+	}
+
+	for (i = 0; i < new_el->num_values; i++) {
+		if (new_kept[i]) {
+			continue;
+		}
+		ret = ldb_kv_index_add1(module, ldb_kv, msg, new_el, i);
+		if (ret != LDB_SUCCESS) {
+			talloc_free(tmp_ctx);
+			return ret;
+		}
+	}
+
+	talloc_free(tmp_ctx);
+	return LDB_SUCCESS;
+}
+
 /*
   delete the index entries for a record
   return -1 on failure
@@ -3698,6 +3698,131 @@ static void test_ldb_add_to_index_duplicates_allowed(void **state)
 	talloc_free(tmp_ctx);
 }
 
+/*
+ * Returns the number of entries listed in the index record for
+ * cn=value, as a stale entry would not show up in a search result
+ */
+static unsigned int index_entry_count(struct ldbtest_ctx *test_ctx,
+				      TALLOC_CTX *mem_ctx,
+				      const char *value)
+{
+	struct ldb_result *result = NULL;
+	struct ldb_message_element *el = NULL;
+	struct ldb_dn *dn = NULL;
+	int ret;
+
+	dn = ldb_dn_new_fmt(mem_ctx, test_ctx->ldb, "@INDEX:CN:%s", value);
+	assert_non_null(dn);
+
+	ret = ldb_search(test_ctx->ldb, mem_ctx, &result, dn,
+			 LDB_SCOPE_BASE, NULL, NULL);
+	assert_int_equal(ret, LDB_SUCCESS);
+	if (result->count == 0) {
+		return 0;
+	}
+	assert_int_equal(result->count, 1);
+
+	el = ldb_msg_find_element(result->msgs[0], "@IDX");
+	if (el == NULL) {
+		return 0;
+	}
+#ifdef GUID_IDX
+	assert_int_equal(el->num_values, 1);
+	return el->values[0].length / 16;
+#else
+	return el->num_values;
+#endif
+}
+
+/*
+ * Replacing the values of an indexed attribute only updates the index
+ * entries of the values that change, so check that the index is right
+ * for removed, kept and added values.
+ */
+static void test_ldb_replace_indexed_values(void **state)
+{
+	int ret;
+	struct ldb_message *msg01;
+	struct ldb_message *msg02;
+	struct ldb_message *mod;
+	struct ldbtest_ctx *test_ctx = talloc_get_type_abort(*state,
+							struct ldbtest_ctx);
+	TALLOC_CTX *tmp_ctx;
+
+	unique_values = false;
+
+	tmp_ctx = talloc_new(test_ctx);
+	assert_non_null(tmp_ctx);
+
+	msg01 = ldb_msg_new(tmp_ctx);
+	assert_non_null(msg01);
+
+	msg01->dn = ldb_dn_new_fmt(msg01, test_ctx->ldb, "dc=test01");
+	assert_non_null(msg01->dn);
+
+	ret = ldb_msg_add_string(msg01, "cn", "value_a");
+	assert_int_equal(ret, LDB_SUCCESS);
+	ret = ldb_msg_add_string(msg01, "cn", "value_b");
+	assert_int_equal(ret, LDB_SUCCESS);
+	ret = ldb_msg_add_string(msg01, "cn", "value_c");
+	assert_int_equal(ret, LDB_SUCCESS);
+
+	ret = ldb_msg_add_string(msg01, "objectUUID",
+				 "0123456789abcde1");
+	assert_int_equal(ret, LDB_SUCCESS);
+
+	ret = ldb_add(test_ctx->ldb, msg01);
+	assert_int_equal(ret, LDB_SUCCESS);
+
+	msg02 = ldb_msg_new(tmp_ctx);
+	assert_non_null(msg02);
+
+	msg02->dn = ldb_dn_new_fmt(msg02, test_ctx->ldb, "dc=test02");
+	assert_non_null(msg02->dn);
+
+	ret = ldb_msg_add_string(msg02, "cn", "value_a");
+	assert_int_equal(ret, LDB_SUCCESS);
+
+	ret = ldb_msg_add_string(msg02, "objectUUID",
+				 "0123456789abcde2");
+	assert_int_equal(ret, LDB_SUCCESS);
+
+	ret = ldb_add(test_ctx->ldb, msg02);
+	assert_int_equal(ret, LDB_SUCCESS);
+
+	mod = ldb_msg_new(tmp_ctx);
+	assert_non_null(mod);
+
+	mod->dn = ldb_dn_new_fmt(mod, test_ctx->ldb, "dc=test01");
+	assert_non_null(mod->dn);
+
+	ret = ldb_msg_add_empty(mod, "cn", LDB_FLAG_MOD_REPLACE, NULL);
+	assert_int_equal(ret, LDB_SUCCESS);
+	ret = ldb_msg_add_string(mod, "cn", "value_c");
+	assert_int_equal(ret, LDB_SUCCESS);
+	ret = ldb_msg_add_string(mod, "cn", "value_d");
+	assert_int_equal(ret, LDB_SUCCESS);
+	ret = ldb_msg_add_string(mod, "cn", "value_b");
+	assert_int_equal(ret, LDB_SUCCESS);
+
+	ret = ldb_modify(test_ctx->ldb, mod);
+	assert_int_equal(ret, LDB_SUCCESS);
+
+	assert_int_equal(index_entry_count(test_ctx, tmp_ctx, "value_a"), 1);
+	assert_int_equal(index_entry_count(test_ctx, tmp_ctx, "value_b"), 1);
+	assert_int_equal(index_entry_count(test_ctx, tmp_ctx, "value_c"), 1);
+	assert_int_equal(index_entry_count(test_ctx, tmp_ctx, "value_d"), 1);
+
+	assert_int_equal(sub_search_count(test_ctx, "dc=test02",
+					  "(cn=value_a)"), 1);
+	assert_int_equal(sub_search_count(test_ctx, "dc=test01",
+					  "(cn=value_a)"), 0);
+	assert_int_equal(sub_search_count(test_ctx, "dc=test01",
+					  "(cn=value_d)"), 1);
+
+	talloc_free(tmp_ctx);
+}
+
 static void test_ldb_add_to_index_unique_values_required(void **state)
 {
 	int ret;
@@ -4667,6 +4792,10 @@ int main(int argc, const char **argv)
 			test_ldb_add_to_index_duplicates_allowed,
 			ldb_non_unique_index_test_setup,
 			ldb_non_unique_index_test_teardown),
+		cmocka_unit_test_setup_teardown(
+			test_ldb_replace_indexed_values,
+			ldb_non_unique_index_test_setup,
+			ldb_non_unique_index_test_teardown),
 		cmocka_unit_test_setup_teardown(
 			test_ldb_add_to_index_unique_values_required,
 			ldb_non_unique_index_test_setup,
@@ -61,6 +61,7 @@ static bool memcache_is_talloc(enum memcache_number n)
 	case SHARE_MODE_LOCK_CACHE:
 	case GETWD_CACHE:
 	case VIRUSFILTER_SCAN_RESULTS_CACHE_TALLOC:
+	case DNS_RECORD_CACHE_TALLOC:
 		result = true;
 		break;
 	default:
@@ -46,6 +46,10 @@ enum memcache_number {
 	SMB1_SEARCH_OFFSET_MAP,
 	SHARE_MODE_LOCK_CACHE,	/* talloc */
 	VIRUSFILTER_SCAN_RESULTS_CACHE_TALLOC, /* talloc */
+	DNS_RECORD_CACHE_TALLOC, /* talloc */
+	DNS_FORWARDER_CACHE,
+	WB_GETTOKEN_CACHE,
+	GENCACHE_RECORD_CACHE,
 	DFREE_CACHE,
 };
 
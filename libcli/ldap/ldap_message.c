@@ -386,13 +386,224 @@ static bool ldap_encode_response(struct asn1_data *data, struct ldap_Result *res
 	return true;
 }
 
+/*
+ * Helpers for the two pass (size, then write) encoding of
+ * SearchResultEntry messages. They produce exactly the same
+ * definite length encoding as asn1_pop_tag().
+ */
+#define LDAP_BER_MAX_LENGTH ((size_t)0xFFFFFFFF)
+
+static size_t ldap_ber_length_size(size_t len)
+{
+	if (len > 0xFFFFFF) {
+		return 5;
+	} else if (len > 0xFFFF) {
+		return 4;
+	} else if (len > 0xFF) {
+		return 3;
+	} else if (len > 0x7F) {
+		return 2;
+	}
+	return 1;
+}
+
+/*
+ * Add the size of a tag/length/value triple with the given
+ * content length to *total, returns false on overflow.
+ */
+static bool ldap_ber_add_tlv_size(size_t *total, size_t len)
+{
+	size_t tlv;
+
+	if (len > LDAP_BER_MAX_LENGTH) {
+		return false;
+	}
+	tlv = 1 + ldap_ber_length_size(len) + len;
+	if (*total + tlv < *total) {
+		return false;
+	}
+	*total += tlv;
+	return true;
+}
+
+static uint8_t *ldap_ber_push_header(uint8_t *p, uint8_t tag, size_t len)
+{
+	size_t n = ldap_ber_length_size(len);
+
+	*p++ = tag;
+	if (n == 1) {
+		*p++ = len;
+		return p;
+	}
+	*p++ = 0x80 | (n - 1);
+	for (n = n - 1; n > 0; n--) {
+		*p++ = (len >> ((n - 1) * 8)) & 0xFF;
+	}
+	return p;
+}
+
+static uint8_t *ldap_ber_push_octet_string(uint8_t *p,
+					   const void *data,
+					   size_t len)
+{
+	p = ldap_ber_push_header(p, ASN1_OCTET_STRING, len);
+	if (len != 0) {
+		memcpy(p, data, len);
+	}
+	return p + len;
+}
+
+static bool ldap_search_entry_attr_sizes(const struct ldb_message_element *attr,
+					 size_t *vals_len,
+					 size_t *attr_len)
+{
+	unsigned int j;
+
+	*vals_len = 0;
+	for (j = 0; j < attr->num_values; j++) {
+		if (!ldap_ber_add_tlv_size(vals_len,
+					   attr->values[j].length)) {
+			return false;
+		}
+	}
+
+	*attr_len = 0;
+	if (!ldap_ber_add_tlv_size(attr_len, strlen(attr->name))) {
+		return false;
+	}
+	return ldap_ber_add_tlv_size(attr_len, *vals_len);
+}
+
+/*
+ * Encode a SearchResultEntry without controls with a single
+ * allocation and no memmove() of nested structures.
+ *
+ * Returns false if the message can't be encoded this way,
+ * the caller falls back to the generic asn1 encoder.
+ */
+static bool ldap_encode_search_entry(const struct ldap_message *msg,
+				     DATA_BLOB *result,
+				     TALLOC_CTX *mem_ctx)
+{
+	const struct ldap_SearchResEntry *r = &msg->r.SearchResultEntry;
+	uint8_t msgid[5];
+	size_t msgid_len = 0;
+	size_t dn_len = strlen(r->dn);
+	size_t attrs_len = 0;
+	size_t entry_len = 0;
+	size_t msg_len = 0;
+	size_t total = 0;
+	uint32_t id;
+	uint8_t *buf = NULL;
+	uint8_t *p = NULL;
+	int i;
+
+	if (msg->messageid < 0) {
+		return false;
+	}
+
+	/*
+	 * Minimal big endian encoding as in asn1_write_Integer(),
+	 * with a leading 0 if the highest bit is set
+	 */
+	id = msg->messageid;
+	do {
+		memmove(msgid + 1, msgid, msgid_len);
+		msgid[0] = id & 0xFF;
+		msgid_len += 1;
+		id >>= 8;
+	} while (id != 0);
+	if (msgid[0] & 0x80) {
+		memmove(msgid + 1, msgid, msgid_len);
+		msgid[0] = 0;
+		msgid_len += 1;
+	}
+
+	/* First pass: calculate the size of everything */
+	for (i = 0; i < r->num_attributes; i++) {
+		size_t vals_len, attr_len;
+
+		if (!ldap_search_entry_attr_sizes(&r->attributes[i],
+						  &vals_len,
+						  &attr_len)) {
+			return false;
+		}
+		if (!ldap_ber_add_tlv_size(&attrs_len, attr_len)) {
+			return false;
+		}
+	}
+
+	if (!ldap_ber_add_tlv_size(&entry_len, dn_len)) {
+		return false;
+	}
+	if (!ldap_ber_add_tlv_size(&entry_len, attrs_len)) {
+		return false;
+	}
+
+	if (!ldap_ber_add_tlv_size(&msg_len, msgid_len)) {
+		return false;
+	}
+	if (!ldap_ber_add_tlv_size(&msg_len, entry_len)) {
+		return false;
+	}
+
+	if (!ldap_ber_add_tlv_size(&total, msg_len)) {
+		return false;
+	}
+
+	buf = talloc_size(mem_ctx, total);
+	if (buf == NULL) {
+		return false;
+	}
+
+	/* Second pass: write everything in place */
+	p = ldap_ber_push_header(buf, ASN1_SEQUENCE(0), msg_len);
+	p = ldap_ber_push_header(p, ASN1_INTEGER, msgid_len);
+	memcpy(p, msgid, msgid_len);
+	p += msgid_len;
+	p = ldap_ber_push_header(p, ASN1_APPLICATION(msg->type), entry_len);
+	p = ldap_ber_push_octet_string(p, r->dn, dn_len);
+	p = ldap_ber_push_header(p, ASN1_SEQUENCE(0), attrs_len);
+	for (i = 0; i < r->num_attributes; i++) {
+		const struct ldb_message_element *attr = &r->attributes[i];
+		size_t vals_len, attr_len;
+		unsigned int j;
+
+		/* Already checked in the first pass */
+		ldap_search_entry_attr_sizes(attr, &vals_len, &attr_len);
+
+		p = ldap_ber_push_header(p, ASN1_SEQUENCE(0), attr_len);
+		p = ldap_ber_push_octet_string(p, attr->name,
+					       strlen(attr->name));
+		p = ldap_ber_push_header(p, ASN1_SEQUENCE(1), vals_len);
+		for (j = 0; j < attr->num_values; j++) {
+			p = ldap_ber_push_octet_string(p,
+						       attr->values[j].data,
+						       attr->values[j].length);
+		}
+	}
+
+	SMB_ASSERT(p == buf + total);
+
+	*result = data_blob_const(buf, total);
+	return true;
+}
+
 _PUBLIC_ bool ldap_encode(struct ldap_message *msg,
 			  const struct ldap_control_handler *control_handlers,
 			  DATA_BLOB *result, TALLOC_CTX *mem_ctx)
 {
-	struct asn1_data *data = asn1_init(mem_ctx, ASN1_MAX_TREE_DEPTH);
+	struct asn1_data *data = NULL;
 	int i, j;
 
+	if (msg->type == LDAP_TAG_SearchResultEntry &&
+	    msg->controls == NULL &&
+	    ldap_encode_search_entry(msg, result, mem_ctx))
+	{
+		return true;
+	}
+
+	data = asn1_init(mem_ctx, ASN1_MAX_TREE_DEPTH);
 	if (!data) return false;
 
 	if (!asn1_push_tag(data, ASN1_SEQUENCE(0))) goto err;
@@ -315,6 +315,254 @@ static void test_decode_exop_response(void **state)
 	assert_true(ret == 0);
 }
 
+/*
+ * Encode a SearchResultEntry the way ldap_encode() does it for all
+ * other message types, using the generic asn1 helpers.
+ */
+static bool asn1_encode_search_entry(struct ldap_message *msg,
+				     DATA_BLOB *result,
+				     TALLOC_CTX *mem_ctx)
+{
+	struct ldap_SearchResEntry *r = &msg->r.SearchResultEntry;
+	struct asn1_data *data = asn1_init(mem_ctx, ASN1_MAX_TREE_DEPTH);
+	int i;
+	unsigned int j;
+	bool ok = true;
+
+	if (data == NULL) {
+		return false;
+	}
+
+	ok &= asn1_push_tag(data, ASN1_SEQUENCE(0));
+	ok &= asn1_write_Integer(data, msg->messageid);
+	ok &= asn1_push_tag(data, ASN1_APPLICATION(msg->type));
+	ok &= asn1_write_OctetString(data, r->dn, strlen(r->dn));
+	ok &= asn1_push_tag(data, ASN1_SEQUENCE(0));
+	for (i = 0; i < r->num_attributes; i++) {
+		struct ldb_message_element *attr = &r->attributes[i];
+		ok &= asn1_push_tag(data, ASN1_SEQUENCE(0));
+		ok &= asn1_write_OctetString(data, attr->name,
+					     strlen(attr->name));
+		ok &= asn1_push_tag(data, ASN1_SEQUENCE(1));
+		for (j = 0; j < attr->num_values; j++) {
+			ok &= asn1_write_OctetString(data,
+						     attr->values[j].data,
+						     attr->values[j].length);
+		}
+		ok &= asn1_pop_tag(data);
+		ok &= asn1_pop_tag(data);
+	}
+	ok &= asn1_pop_tag(data);
+	ok &= asn1_pop_tag(data);
+	ok &= asn1_pop_tag(data);
+	ok &= asn1_extract_blob(data, mem_ctx, result);
+
+	asn1_free(data);
+	return ok;
+}
+
+/*
+ * Build a SearchResultEntry looking like a typical user object,
+ * value_size != 0 adds a value of that size to the description.
+ */
+static struct ldap_message *make_search_entry(TALLOC_CTX *mem_ctx,
+					      int messageid,
+					      size_t value_size)
+{
+	static const char * const attrs[][2] = {
+		{ "objectClass", "user" },
+		{ "cn", "Test User" },
+		{ "sn", "User" },
+		{ "givenName", "Test" },
+		{ "distinguishedName",
+		  "CN=Test User,CN=Users,DC=samba,DC=example,DC=com" },
+		{ "instanceType", "4" },
+		{ "whenCreated", "20200101000000.0Z" },
+		{ "whenChanged", "20200101000000.0Z" },
+		{ "displayName", "Test User" },
+		{ "uSNCreated", "4711" },
+		{ "uSNChanged", "4712" },
+		{ "name", "Test User" },
+		{ "userAccountControl", "512" },
+		{ "primaryGroupID", "513" },
+		{ "sAMAccountName", "testuser" },
+		{ "sAMAccountType", "805306368" },
+		{ "userPrincipalName", "testuser@samba.example.com" },
+		{ "objectCategory",
+		  "CN=Person,CN=Schema,CN=Configuration,"
+		  "DC=samba,DC=example,DC=com" },
+	};
+	struct ldap_message *msg = NULL;
+	struct ldap_SearchResEntry *r = NULL;
+	size_t num_attrs = ARRAY_SIZE(attrs) + 2;
+	size_t i;
+
+	msg = talloc_zero(mem_ctx, struct ldap_message);
+	assert_non_null(msg);
+	msg->messageid = messageid;
+	msg->type = LDAP_TAG_SearchResultEntry;
+
+	r = &msg->r.SearchResultEntry;
+	r->dn = "CN=Test User,CN=Users,DC=samba,DC=example,DC=com";
+	r->num_attributes = num_attrs;
+	r->attributes = talloc_zero_array(msg,
+					  struct ldb_message_element,
+					  num_attrs);
+	assert_non_null(r->attributes);
+
+	for (i = 0; i < ARRAY_SIZE(attrs); i++) {
+		struct ldb_message_element *el = &r->attributes[i];
+
+		el->name = attrs[i][0];
+		el->num_values = 1;
+		el->values = talloc_zero(r->attributes, struct ldb_val);
+		assert_non_null(el->values);
+		el->values[0] = data_blob_string_const(attrs[i][1]);
+	}
+
+	/* An attribute without values, as with attributesonly */
+	r->attributes[i].name = "memberOf";
+	i++;
+
+	r->attributes[i].name = "description";
+	r->attributes[i].num_values = 2;
+	r->attributes[i].values = talloc_zero_array(r->attributes,
+						    struct ldb_val,
+						    2);
+	assert_non_null(r->attributes[i].values);
+	r->attributes[i].values[0] = data_blob_string_const("");
+	r->attributes[i].values[1] = data_blob_talloc_zero(r->attributes,
+							   value_size);
+
+	return msg;
+}
+
+/*
+ * Check that the single allocation SearchResultEntry encoder gives
+ * exactly the same result as the generic asn1 encoder, for all
+ * variants of the BER length encoding.
+ *
+ * The sized value is the last one of the message, so it must be the
+ * last bytes of the encoding, preceded by the OCTET STRING tag and
+ * the expected length octets.
+ */
+static void test_encode_search_entry(void **state)
+{
+	struct test_ctx *test_ctx = talloc_get_type_abort(
+		*state,
+		struct test_ctx);
+	static const int ids[] = { 0, 1, 127, 128, 255, 256, 32768,
+				   0x7FFFFF, 0x800000, 0x7FFFFFFF };
+	static const struct {
+		size_t size;
+		size_t hdr_len;
+		uint8_t hdr[6];
+	} values[] = {
+		{ 0, 2, { ASN1_OCTET_STRING, 0x00 } },
+		{ 1, 2, { ASN1_OCTET_STRING, 0x01 } },
+		{ 64, 2, { ASN1_OCTET_STRING, 0x40 } },
+		{ 0x7F, 2, { ASN1_OCTET_STRING, 0x7F } },
+		{ 0x80, 3, { ASN1_OCTET_STRING, 0x81, 0x80 } },
+		{ 200, 3, { ASN1_OCTET_STRING, 0x81, 0xC8 } },
+		{ 0xFF, 3, { ASN1_OCTET_STRING, 0x81, 0xFF } },
+		{ 0x100, 4, { ASN1_OCTET_STRING, 0x82, 0x01, 0x00 } },
+		{ 0xFFFF, 4, { ASN1_OCTET_STRING, 0x82, 0xFF, 0xFF } },
+		{ 0x10000, 5, { ASN1_OCTET_STRING, 0x83, 0x01, 0x00, 0x00 } },
+		{ 70000, 5, { ASN1_OCTET_STRING, 0x83, 0x01, 0x11, 0x70 } },
+		{ 0xFFFFFF, 5, { ASN1_OCTET_STRING, 0x83, 0xFF, 0xFF, 0xFF } },
+		{ 0x1000000, 6,
+		  { ASN1_OCTET_STRING, 0x84, 0x01, 0x00, 0x00, 0x00 } },
+	};
+	size_t i, j, k;
+
+	for (i = 0; i < ARRAY_SIZE(ids); i++) {
+		for (j = 0; j < ARRAY_SIZE(values); j++) {
+			TALLOC_CTX *frame = talloc_new(test_ctx);
+			struct ldap_message *msg = NULL;
+			DATA_BLOB fast = data_blob_null;
+			DATA_BLOB generic = data_blob_null;
+			size_t len = values[j].size;
+			size_t hdr_len = values[j].hdr_len;
+			size_t value_ofs;
+			bool ok;
+
+			msg = make_search_entry(frame, ids[i], len);
+
+			ok = ldap_encode(msg, NULL, &fast, frame);
+			assert_true(ok);
+
+			ok = asn1_encode_search_entry(msg, &generic, frame);
+			assert_true(ok);
+
+			assert_int_equal(fast.length, generic.length);
+			assert_memory_equal(fast.data,
+					    generic.data,
+					    fast.length);
+
+			assert_true(fast.length > len + hdr_len);
+			value_ofs = fast.length - len;
+			assert_memory_equal(fast.data + value_ofs - hdr_len,
+					    values[j].hdr,
+					    hdr_len);
+			for (k = value_ofs; k < fast.length; k++) {
+				if (fast.data[k] != 0) {
+					break;
+				}
+			}
+			assert_int_equal(k, fast.length);
+
+			TALLOC_FREE(frame);
+		}
+	}
+}
+
+/*
+ * Microbenchmark of the SearchResultEntry encoding of a typical user
+ * object, compared to the generic asn1 encoder.
+ *
+ * This only prints timings, so it is skipped unless
+ * LDAP_MESSAGE_TEST_BENCHMARK is set in the environment.
+ */
+static void test_encode_search_entry_speed(void **state)
+{
+	struct test_ctx *test_ctx = talloc_get_type_abort(
+		*state,
+		struct test_ctx);
+	const size_t count = 20000;
+	struct ldap_message *msg = NULL;
+	struct timeval start;
+	double fast_time, generic_time;
+	size_t i;
+
+	if (getenv("LDAP_MESSAGE_TEST_BENCHMARK") == NULL) {
+		skip();
+	}
+
+	msg = make_search_entry(test_ctx, 4711, 100);
+
+	start = timeval_current();
+	for (i = 0; i < count; i++) {
+		DATA_BLOB blob = data_blob_null;
+		bool ok = ldap_encode(msg, NULL, &blob, test_ctx);
+		assert_true(ok);
+		data_blob_free(&blob);
+	}
+	fast_time = timeval_elapsed(&start);
+
+	start = timeval_current();
+	for (i = 0; i < count; i++) {
+		DATA_BLOB blob = data_blob_null;
+		bool ok = asn1_encode_search_entry(msg, &blob, test_ctx);
+		assert_true(ok);
+		data_blob_free(&blob);
+	}
+	generic_time = timeval_elapsed(&start);
+
+	print_message("Encoded %zu SearchResultEntry messages: "
+		      "single allocation %.3fs, asn1 %.3fs\n",
+		      count, fast_time, generic_time);
+}
+
 int main(_UNUSED_ int argc, _UNUSED_ const char **argv)
 {
 	const struct CMUnitTest tests[] = {
@@ -338,6 +586,14 @@ int main(_UNUSED_ int argc, _UNUSED_ const char **argv)
 			test_decode_exop_response,
 			setup,
 			teardown),
+		cmocka_unit_test_setup_teardown(
+			test_encode_search_entry,
+			setup,
+			teardown),
+		cmocka_unit_test_setup_teardown(
+			test_encode_search_entry_speed,
+			setup,
+			teardown),
 	};
 
 	cmocka_set_message_output(CM_OUTPUT_SUBUNIT);
@@ -486,6 +486,76 @@ static void nss_test_errors(void)
 	}
 }
 
+/*
+ * With winbind_off() (the _NO_WINBINDD environment variable) set
+ * callers only want to see local accounts, even if the same
+ * account was just returned by winbindd.
+ */
+static void nss_test_winbind_off(void)
+{
+	struct passwd *pwd;
+	struct group *grp;
+	char *name = NULL;
+	uid_t uid;
+	gid_t gid;
+
+	samba_nss_setpwent();
+	pwd = nss_getpwent();
+	samba_nss_endpwent();
+	if (pwd == NULL) {
+		return;
+	}
+
+	name = strdup(pwd->pw_name);
+	if (name == NULL) {
+		exit(1);
+	}
+	uid = pwd->pw_uid;
+	gid = pwd->pw_gid;
+
+	printf("Testing winbind off with user %s\n", name);
+
+	/* Make sure the entries are known to the library */
+	pwd = nss_getpwuid(uid);
+	if (pwd == NULL) {
+		total_errors++;
+		printf("ERROR: can't getpwuid\n");
+	}
+	pwd = nss_getpwnam(name);
+	if (pwd == NULL) {
+		total_errors++;
+		printf("ERROR: can't getpwnam\n");
+	}
+	grp = nss_getgrgid(gid);
+
+	setenv("_NO_WINBINDD", "1", 1);
+
+	pwd = nss_getpwuid(uid);
+	if (pwd != NULL) {
+		total_errors++;
+		printf("ERROR: getpwuid with winbind off found %s\n",
+		       pwd->pw_name);
+	}
+	pwd = nss_getpwnam(name);
+	if (pwd != NULL) {
+		total_errors++;
+		printf("ERROR: getpwnam with winbind off found %s\n",
+		       pwd->pw_name);
+	}
+	if (grp != NULL) {
+		grp = nss_getgrgid(gid);
+		if (grp != NULL) {
+			total_errors++;
+			printf("ERROR: getgrgid with winbind off found %s\n",
+			       grp->gr_name);
+		}
+	}
+
+	setenv("_NO_WINBINDD", "0", 1);
+
+	SAFE_FREE(name);
+}
+
  int main(int argc, char *argv[])
 {
 	if (argc > 1) so_path = argv[1];
@@ -494,6 +564,7 @@ static void nss_test_errors(void)
 	nss_test_users();
 	nss_test_groups();
 	nss_test_errors();
+	nss_test_winbind_off();
 
 	printf("total_errors=%d\n", total_errors);
 
@@ -20,6 +20,7 @@
 */
 
 #include "winbind_client.h"
+#include "system/time.h"
 
 #ifdef HAVE_PTHREAD_H
 #include <pthread.h>
@@ -346,6 +347,108 @@ static NSS_STATUS fill_grent(struct group *result, struct winbindd_gr *gr,
 	return NSS_STATUS_SUCCESS;
 }
 
+/*
+ * A small per-thread cache of the last users and groups returned by
+ * winbindd, so that tools resolving the owner of many files (ls -l,
+ * find, du, tar ...) do not need a round trip to winbindd for every
+ * file. Entries are only kept for a few seconds, so changes made in
+ * winbindd are still seen almost immediately. Groups are only cached
+ * when they come without a member list, as the members are returned
+ * in the variable sized extra data. Failed lookups are never cached.
+ * Like winbindd_request_response(), the cache honours winbind_off(),
+ * callers use that to see only local accounts.
+ */
+
+#define WB_NSS_CACHE_SIZE 4
+#define WB_NSS_CACHE_TTL 5
+
+struct wb_nss_pw_cache_entry {
+	time_t expires;
+	struct winbindd_pw pw;
+};
+
+struct wb_nss_gr_cache_entry {
+	time_t expires;
+	struct winbindd_gr gr;
+};
+
+static __thread struct wb_nss_pw_cache_entry pw_cache[WB_NSS_CACHE_SIZE];
+static __thread unsigned int pw_cache_next;
+static __thread struct wb_nss_gr_cache_entry gr_cache[WB_NSS_CACHE_SIZE];
+static __thread unsigned int gr_cache_next;
+
+static struct winbindd_pw *pw_cache_find(uid_t uid, const char *name)
+{
+	time_t now = time(NULL);
+	unsigned int i;
+
+	if (winbind_env_set()) {
+		return NULL;
+	}
+
+	for (i = 0; i < WB_NSS_CACHE_SIZE; i++) {
+		struct wb_nss_pw_cache_entry *e = &pw_cache[i];
+
+		if (e->expires <= now) {
+			continue;
+		}
+		if (name != NULL) {
+			if (strcmp(e->pw.pw_name, name) == 0) {
+				return &e->pw;
+			}
+		} else if (e->pw.pw_uid == uid) {
+			return &e->pw;
+		}
+	}
+
+	return NULL;
+}
+
+static void pw_cache_add(const struct winbindd_pw *pw)
+{
+	struct wb_nss_pw_cache_entry *e = &pw_cache[pw_cache_next];
+
+	e->expires = time(NULL) + WB_NSS_CACHE_TTL;
+	e->pw = *pw;
+
+	pw_cache_next = (pw_cache_next + 1) % WB_NSS_CACHE_SIZE;
+}
+
+static struct winbindd_gr *gr_cache_find(gid_t gid)
+{
+	time_t now = time(NULL);
+	unsigned int i;
+
+	if (winbind_env_set()) {
+		return NULL;
+	}
+
+	for (i = 0; i < WB_NSS_CACHE_SIZE; i++) {
+		struct wb_nss_gr_cache_entry *e = &gr_cache[i];
+
+		if (e->expires > now && e->gr.gr_gid == gid) {
+			return &e->gr;
+		}
+	}
+
+	return NULL;
+}
+
+static void gr_cache_add(const struct winbindd_gr *gr)
+{
+	struct wb_nss_gr_cache_entry *e = NULL;
+
+	if (gr->num_gr_mem != 0) {
+		return;
+	}
+
+	e = &gr_cache[gr_cache_next];
+	e->expires = time(NULL) + WB_NSS_CACHE_TTL;
+	e->gr = *gr;
+
+	gr_cache_next = (gr_cache_next + 1) % WB_NSS_CACHE_SIZE;
+}
+
 /*
  * NSS user functions
  */
@@ -508,11 +611,21 @@ _nss_winbind_getpwuid_r(uid_t uid, struct passwd *result, char *buffer,
 	static __thread struct winbindd_response response;
 	struct winbindd_request request;
 	static __thread int keep_response;
+	struct winbindd_pw *cached = NULL;
 
 #ifdef DEBUG_NSS
 	fprintf(stderr, "[%5d]: getpwuid_r %d\n", getpid(), (unsigned int)uid);
 #endif
 
+	cached = pw_cache_find(uid, NULL);
+	if (cached != NULL) {
+		ret = fill_pwent(result, cached, &buffer, &buflen);
+		if (ret == NSS_STATUS_TRYAGAIN) {
+			*errnop = errno = ERANGE;
+		}
+		goto done;
+	}
+
 	/* If our static buffer needs to be expanded we are called again */
 	if (!keep_response || uid != response.data.pw.pw_uid) {
 
@@ -532,6 +645,7 @@ _nss_winbind_getpwuid_r(uid_t uid, struct passwd *result, char *buffer,
 		ret = winbindd_request_response(NULL, WINBINDD_GETPWUID, &request, &response);
 
 		if (ret == NSS_STATUS_SUCCESS) {
+			pw_cache_add(&response.data.pw);
 			ret = fill_pwent(result, &response.data.pw,
 					 &buffer, &buflen);
 
@@ -579,11 +693,21 @@ _nss_winbind_getpwnam_r(const char *name, struct passwd *result, char *buffer,
 	static __thread struct winbindd_response response;
 	struct winbindd_request request;
 	static __thread int keep_response;
+	struct winbindd_pw *cached = NULL;
 
 #ifdef DEBUG_NSS
 	fprintf(stderr, "[%5d]: getpwnam_r %s\n", getpid(), name);
 #endif
 
+	cached = pw_cache_find(0, name);
+	if (cached != NULL) {
+		ret = fill_pwent(result, cached, &buffer, &buflen);
+		if (ret == NSS_STATUS_TRYAGAIN) {
+			*errnop = errno = ERANGE;
+		}
+		goto done;
+	}
+
 	/* If our static buffer needs to be expanded we are called again */
 
 	if (!keep_response || strcmp(name,response.data.pw.pw_name) != 0) {
@@ -606,6 +730,7 @@ _nss_winbind_getpwnam_r(const char *name, struct passwd *result, char *buffer,
 		ret = winbindd_request_response(NULL, WINBINDD_GETPWNAM, &request, &response);
 
 		if (ret == NSS_STATUS_SUCCESS) {
+			pw_cache_add(&response.data.pw);
 			ret = fill_pwent(result, &response.data.pw, &buffer,
 					 &buflen);
 
@@ -912,11 +1037,21 @@ _nss_winbind_getgrgid_r(gid_t gid,
 	static __thread struct winbindd_response response;
 	struct winbindd_request request;
 	static __thread int keep_response;
+	struct winbindd_gr *cached = NULL;
 
 #ifdef DEBUG_NSS
 	fprintf(stderr, "[%5d]: getgrgid %d\n", getpid(), gid);
 #endif
 
+	cached = gr_cache_find(gid);
+	if (cached != NULL) {
+		ret = fill_grent(result, cached, NULL, &buffer, &buflen);
+		if (ret == NSS_STATUS_TRYAGAIN) {
+			*errnop = errno = ERANGE;
+		}
+		goto done;
+	}
+
 	/* If our static buffer needs to be expanded we are called again */
 	/* Or if the stored response group name differs from the request. */
 
@@ -939,6 +1074,7 @@ _nss_winbind_getgrgid_r(gid_t gid,
 						&request, &response);
 
 		if (ret == NSS_STATUS_SUCCESS) {
+			gr_cache_add(&response.data.gr);
 
 			ret = fill_grent(result, &response.data.gr,
 					 (char *)response.extra_data.data,
@@ -100,8 +100,11 @@ def sendDsReplicaSync(drsuapiBind, drsuapi_handle, source_dsa_guid,
         raise drsException("DsReplicaSync failed %s" % estr)
 
 
-def drs_DsBind(drs):
-    """make a DsBind call, returning the binding handle"""
+def drs_DsBind(drs, exclude_extensions=0):
+    """make a DsBind call, returning the binding handle
+
+    exclude_extensions are DRSUAPI_SUPPORTED_EXTENSION_* flags not to
+    advertise to the server"""
     bind_info = drsuapi.DsBindInfoCtr()
     bind_info.length = 28
     bind_info.info = drsuapi.DsBindInfo28()
@@ -133,6 +136,7 @@ def drs_DsBind(drs):
     bind_info.info.supported_extensions |= drsuapi.DRSUAPI_SUPPORTED_EXTENSION_ADDENTRYREPLY_V3
     bind_info.info.supported_extensions |= drsuapi.DRSUAPI_SUPPORTED_EXTENSION_GETCHGREPLY_V7
     bind_info.info.supported_extensions |= drsuapi.DRSUAPI_SUPPORTED_EXTENSION_VERIFY_OBJECT
+    bind_info.info.supported_extensions &= ~exclude_extensions
     (info, handle) = drs.DsBind(misc.GUID(drsuapi.DRSUAPI_DS_BIND_GUID), bind_info)
 
     return (handle, info.info.supported_extensions)
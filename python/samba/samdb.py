@@ -1523,6 +1523,25 @@ schemaUpdateNow: 1
         """return a new RID from the RID Pool on this DSA"""
         return dsdb._dsdb_allocate_rid(self)
 
+    def sd_propagation_batch(self, max_objects=0):
+        """process the next batch of the queued security descriptor
+        propagation in its own transaction, see
+        "dsdb:sd propagation batch size".
+
+        :param max_objects: the maximum number of objects to update, 0 means
+            the "dsdb:sd propagation batch size" of this connection
+        :return: (num_processed, num_pending)
+        """
+        self.transaction_start()
+        try:
+            ret = dsdb._dsdb_sd_propagation_batch(self, max_objects)
+        except:
+            self.transaction_cancel()
+            raise
+        else:
+            self.transaction_commit()
+        return ret
+
     def next_free_rid(self):
         """return the next free RID from the RID Pool on this DSA.
 
@@ -0,0 +1,331 @@
+# Unix SMB/CIFS implementation. Tests for security descriptor propagation
+#
+# This program is free software; you can redistribute it and/or modify
+# it under the terms of the GNU General Public License as published by
+# the Free Software Foundation; either version 3 of the License, or
+# (at your option) any later version.
+#
+# This program is distributed in the hope that it will be useful,
+# but WITHOUT ANY WARRANTY; without even the implied warranty of
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+# GNU General Public License for more details.
+#
+# You should have received a copy of the GNU General Public License
+# along with this program.  If not, see <http://www.gnu.org/licenses/>.
+#
+
+"""Tests for the security descriptor propagation of the descriptor module.
+
+These run against a private provision, so that no KCC processes the
+background propagation queue behind our back.
+"""
+
+import uuid
+
+import ldb
+from samba.dcerpc import misc, security
+from samba.ndr import ndr_unpack
+from samba.samdb import SamDB
+from samba.sd_utils import SDUtils
+from samba.tests.samdb import SamDBTestCase
+
+BATCH_SIZE = 5
+NUM_CHILDREN = 20
+
+QUEUE_DN = "@SD_PROPAGATION"
+
+TRUSTEE_1 = "S-1-5-21-1-2-3-1001"
+TRUSTEE_2 = "S-1-5-21-1-2-3-1002"
+
+
+class SdPropagationTestCase(SamDBTestCase):
+
+    def setUp(self):
+        super().setUp()
+
+        self.samdb = self.connect()
+        self.sd_utils = SDUtils(self.samdb)
+
+        self.ou_dn = ldb.Dn(self.samdb,
+                            "OU=sdprop,%s" % self.samdb.domain_dn())
+        self.samdb.add({"dn": self.ou_dn,
+                        "objectclass": "organizationalUnit"})
+        for i in range(NUM_CHILDREN):
+            self.samdb.add({"dn": "OU=child%d,%s" % (i, self.ou_dn),
+                            "objectclass": "organizationalUnit"})
+
+    def connect(self):
+        return SamDB(url=self.lp.samdb_url(),
+                     session_info=self.session,
+                     lp=self.lp)
+
+    def add_inheritable_ace(self, trustee):
+        self.sd_utils.dacl_add_ace(self.ou_dn, "(A;CI;RPLC;;;%s)" % trustee)
+
+    def children_inheriting(self, trustee):
+        """Return the number of children of the OU that have inherited an
+        ACE for trustee"""
+        sid = security.dom_sid(trustee)
+        res = self.samdb.search(self.ou_dn,
+                                scope=ldb.SCOPE_ONELEVEL,
+                                attrs=["nTSecurityDescriptor"])
+        self.assertEqual(len(res), NUM_CHILDREN)
+
+        count = 0
+        for msg in res:
+            sd = ndr_unpack(security.descriptor,
+                            msg["nTSecurityDescriptor"][0])
+            for ace in sd.dacl.aces:
+                if (ace.trustee == sid and
+                        ace.flags & security.SEC_ACE_FLAG_INHERITED_ACE):
+                    count += 1
+                    break
+        return count
+
+
+class SdPropagationBatchTests(SdPropagationTestCase):
+    """Subtrees larger than "dsdb:sd propagation batch size" are queued
+    in the @SD_PROPAGATION record and processed by separate batches"""
+
+    def setUp(self):
+        super().setUp()
+
+        res = self.samdb.search(self.ou_dn, scope=ldb.SCOPE_BASE,
+                                attrs=["objectGUID"])
+        ou_guid = ndr_unpack(misc.GUID, res[0]["objectGUID"][0])
+        self.nc_root = self.samdb.get_default_basedn()
+        self.queue_value = "%s;%s" % (ou_guid, self.nc_root)
+
+    def connect(self):
+        self.lp.set("dsdb:sd propagation batch size", str(BATCH_SIZE))
+        return super().connect()
+
+    def get_queue(self):
+        """Return the pending propagations and the cursor"""
+        try:
+            res = self.samdb.search(QUEUE_DN,
+                                    scope=ldb.SCOPE_BASE,
+                                    attrs=["pendingPropagation",
+                                           "propagationCursor"])
+        except ldb.LdbError as e:
+            if e.args[0] == ldb.ERR_NO_SUCH_OBJECT:
+                return [], None
+            raise
+
+        pending = [str(v) for v in res[0].get("pendingPropagation", [])]
+        cursor = res[0].get("propagationCursor", idx=0)
+        if cursor is not None:
+            cursor = str(cursor)
+        return pending, cursor
+
+    def run_batches(self):
+        """Run batches until the queue is empty, return the number of
+        objects processed"""
+        total = 0
+        for _ in range(NUM_CHILDREN * 2):
+            num_processed, num_pending = self.samdb.sd_propagation_batch()
+            total += num_processed
+            if num_pending == 0:
+                break
+        else:
+            self.fail("SD propagation did not finish")
+
+        self.assertEqual(self.get_queue(), ([], None))
+        return total
+
+    def test_queued(self):
+        self.add_inheritable_ace(TRUSTEE_1)
+
+        # Nothing happened below the OU yet, the change is queued.
+        self.assertEqual(self.get_queue(), ([self.queue_value], None))
+        self.assertEqual(self.children_inheriting(TRUSTEE_1), 0)
+
+        num_processed, num_pending = self.samdb.sd_propagation_batch()
+        self.assertEqual(num_processed, BATCH_SIZE)
+        self.assertEqual(num_pending, 1)
+        self.assertEqual(self.children_inheriting(TRUSTEE_1), BATCH_SIZE)
+
+        total = self.run_batches()
+        self.assertEqual(total, NUM_CHILDREN - BATCH_SIZE)
+        self.assertEqual(self.children_inheriting(TRUSTEE_1), NUM_CHILDREN)
+
+    def test_resume_after_restart(self):
+        self.add_inheritable_ace(TRUSTEE_1)
+
+        num_processed, num_pending = self.samdb.sd_propagation_batch(7)
+        self.assertEqual(num_processed, 7)
+        self.assertEqual(num_pending, 1)
+
+        pending, cursor = self.get_queue()
+        self.assertEqual(pending, [self.queue_value])
+        self.assertIsNotNone(cursor)
+
+        # A new connection only has the cursor in the database to go by.
+        self.samdb = self.connect()
+
+        # The objects done before the restart are not processed again.
+        total = self.run_batches()
+        self.assertEqual(total, NUM_CHILDREN - 7)
+        self.assertEqual(self.children_inheriting(TRUSTEE_1), NUM_CHILDREN)
+
+    def test_resume_nested(self):
+        for i in range(NUM_CHILDREN):
+            self.samdb.add({"dn": "OU=grandchild,OU=child%d,%s" % (
+                                i, self.ou_dn),
+                            "objectclass": "organizationalUnit"})
+
+        self.add_inheritable_ace(TRUSTEE_1)
+
+        # The batches stop and resume at both levels of the subtree.
+        total = self.run_batches()
+        self.assertEqual(total, NUM_CHILDREN * 2)
+        self.assertEqual(self.children_inheriting(TRUSTEE_1), NUM_CHILDREN)
+
+        sid = security.dom_sid(TRUSTEE_1)
+        res = self.samdb.search(self.ou_dn,
+                                scope=ldb.SCOPE_SUBTREE,
+                                expression="(ou=grandchild)",
+                                attrs=["nTSecurityDescriptor"])
+        self.assertEqual(len(res), NUM_CHILDREN)
+        for msg in res:
+            sd = ndr_unpack(security.descriptor,
+                            msg["nTSecurityDescriptor"][0])
+            self.assertIn(sid, [ace.trustee for ace in sd.dacl.aces])
+
+    def test_requeue_not_started(self):
+        self.add_inheritable_ace(TRUSTEE_1)
+        self.add_inheritable_ace(TRUSTEE_2)
+
+        # The second change is covered by the queued one.
+        self.assertEqual(self.get_queue(), ([self.queue_value], None))
+
+        total = self.run_batches()
+        self.assertEqual(total, NUM_CHILDREN)
+        self.assertEqual(self.children_inheriting(TRUSTEE_1), NUM_CHILDREN)
+        self.assertEqual(self.children_inheriting(TRUSTEE_2), NUM_CHILDREN)
+
+    def test_requeue_in_progress(self):
+        self.add_inheritable_ace(TRUSTEE_1)
+
+        num_processed, num_pending = self.samdb.sd_propagation_batch()
+        self.assertEqual(num_processed, BATCH_SIZE)
+        self.assertEqual(num_pending, 1)
+        self.assertEqual(self.children_inheriting(TRUSTEE_2), 0)
+
+        # Changing the OU again while its subtree is being processed
+        # starts over from the top.
+        self.add_inheritable_ace(TRUSTEE_2)
+        self.assertEqual(self.get_queue(), ([self.queue_value], None))
+
+        total = self.run_batches()
+        self.assertEqual(total, NUM_CHILDREN)
+        self.assertEqual(self.children_inheriting(TRUSTEE_1), NUM_CHILDREN)
+        self.assertEqual(self.children_inheriting(TRUSTEE_2), NUM_CHILDREN)
+
+    def test_deleted_subtree_dropped(self):
+        self.add_inheritable_ace(TRUSTEE_1)
+        self.samdb.delete(self.ou_dn, ["tree_delete:1"])
+
+        num_processed, num_pending = self.samdb.sd_propagation_batch()
+        self.assertEqual(num_processed, 0)
+        self.assertEqual(num_pending, 0)
+        self.assertEqual(self.get_queue(), ([], None))
+
+    def test_missing_guid_dropped(self):
+        missing = "%s;%s" % (uuid.uuid4(), self.nc_root)
+        self.samdb.add({"dn": QUEUE_DN,
+                        "pendingPropagation": missing})
+
+        self.add_inheritable_ace(TRUSTEE_1)
+        self.assertEqual(self.get_queue(),
+                         ([missing, self.queue_value], None))
+
+        # The unknown object is dropped without touching anything.
+        num_processed, num_pending = self.samdb.sd_propagation_batch()
+        self.assertEqual(num_processed, 0)
+        self.assertEqual(num_pending, 1)
+        self.assertEqual(self.get_queue(), ([self.queue_value], None))
+
+        total = self.run_batches()
+        self.assertEqual(total, NUM_CHILDREN)
+        self.assertEqual(self.children_inheriting(TRUSTEE_1), NUM_CHILDREN)
+
+
+class SdPropagationCacheTests(SdPropagationTestCase):
+    """The propagation result is reused for all objects with the same
+    objectClass, parent descriptor and old descriptor"""
+
+    def get_child_sds(self):
+        res = self.samdb.search(self.ou_dn,
+                                scope=ldb.SCOPE_ONELEVEL,
+                                attrs=["nTSecurityDescriptor"])
+        self.assertEqual(len(res), NUM_CHILDREN)
+        return {str(msg.dn.get_rdn_value()):
+                ndr_unpack(security.descriptor,
+                           msg["nTSecurityDescriptor"][0])
+                for msg in res}
+
+    def test_shared_sd(self):
+        before = self.get_child_sds()
+        sddl = {sd.as_sddl() for sd in before.values()}
+        self.assertEqual(len(sddl), 1)
+
+        self.add_inheritable_ace(TRUSTEE_1)
+
+        # All children still share one descriptor, now with the new ACE.
+        after = self.get_child_sds()
+        sddl = {sd.as_sddl() for sd in after.values()}
+        self.assertEqual(len(sddl), 1)
+        self.assertEqual(self.children_inheriting(TRUSTEE_1), NUM_CHILDREN)
+
+    def test_owner_group_change(self):
+        domain_sid = self.sd_utils.domain_sid
+        new_owner = security.dom_sid(
+            "%s-%d" % (domain_sid, security.DOMAIN_RID_ENTERPRISE_ADMINS))
+        new_group = security.dom_sid(
+            "%s-%d" % (domain_sid, security.DOMAIN_RID_USERS))
+
+        before = self.get_child_sds()
+        old_owner = before["child0"].owner_sid
+        old_group = before["child0"].group_sid
+        self.assertNotEqual(old_owner, new_owner)
+        self.assertNotEqual(old_group, new_group)
+
+        owner_dn = "OU=child3,%s" % self.ou_dn
+        group_dn = "OU=child7,%s" % self.ou_dn
+
+        # Within one transaction, so all children are processed by the
+        # same propagation run and share its result cache.
+        self.samdb.transaction_start()
+        try:
+            self.sd_utils.modify_sd_on_dn(
+                owner_dn, "O:%s" % new_owner,
+                controls=["sd_flags:1:%d" % security.SECINFO_OWNER])
+            self.add_inheritable_ace(TRUSTEE_1)
+            self.sd_utils.modify_sd_on_dn(
+                group_dn, "G:%s" % new_group,
+                controls=["sd_flags:1:%d" % security.SECINFO_GROUP])
+        except:
+            self.samdb.transaction_cancel()
+            raise
+        else:
+            self.samdb.transaction_commit()
+
+        self.assertEqual(self.children_inheriting(TRUSTEE_1), NUM_CHILDREN)
+
+        after = self.get_child_sds()
+        for name, sd in after.items():
+            if name == "child3":
+                self.assertEqual(sd.owner_sid, new_owner)
+            else:
+                self.assertEqual(sd.owner_sid, old_owner)
+            if name == "child7":
+                self.assertEqual(sd.group_sid, new_group)
+            else:
+                self.assertEqual(sd.group_sid, old_group)
+
+        # The objects with the common old descriptor still share the
+        # result.
+        sddl = {sd.as_sddl() for name, sd in after.items()
+                if name not in ("child3", "child7")}
+        self.assertEqual(len(sddl), 1)
@@ -197,6 +197,71 @@ class GroupTests(KDCBaseTest):
                             ldb.Dn(samdb, universal_dn),
                             GroupType.DOMAIN_LOCAL)
 
+    def _get_group_member_computer(self):
+        samdb = self.get_samdb()
+
+        # Create a global group.
+        group_dn = self.create_group(samdb,
+                                     self.get_new_username(),
+                                     gtype=GroupType.GLOBAL.value)
+
+        # Get the SID of the group.
+        group_sid = self.get_objectSid(samdb, group_dn)
+
+        # Create a computer account belonging to the group. It can act as
+        # both a client and a service.
+        creds = self.get_cached_creds(
+            account_type=self.AccountType.COMPUTER,
+            opts={
+                'member_of': (
+                    group_dn,
+                ),
+            },
+            use_cache=False)
+
+        expected_groups = {
+            (group_sid, SidType.BASE_SID, self.default_attrs),
+            ...,
+        }
+
+        return creds, expected_groups
+
+    # Look the account up as a server first, which loads fewer attributes
+    # than a client lookup. The groups the KDC computed for the server must
+    # not end up in the PAC of a TGT issued to the same account.
+    def test_groups_server_then_client(self):
+        mach_creds, expected_groups = self._get_group_member_computer()
+
+        user_creds = self.get_cached_creds(
+            account_type=self.AccountType.USER)
+        user_tgt = self.get_tgt(user_creds)
+
+        self.get_service_ticket(user_tgt, mach_creds, fresh=True)
+
+        self.get_tgt(mach_creds,
+                     expected_groups=expected_groups,
+                     fresh=True)
+
+    def test_groups_client_then_server(self):
+        mach_creds, expected_groups = self._get_group_member_computer()
+
+        mach_tgt = self.get_tgt(mach_creds,
+                                expected_groups=expected_groups,
+                                fresh=True)
+
+        user_creds = self.get_cached_creds(
+            account_type=self.AccountType.USER)
+        user_tgt = self.get_tgt(user_creds)
+
+        self.get_service_ticket(user_tgt, mach_creds, fresh=True)
+        self.get_service_ticket(mach_tgt, mach_creds,
+                                expected_groups=expected_groups,
+                                fresh=True)
+
+        self.get_tgt(mach_creds,
+                     expected_groups=expected_groups,
+                     fresh=True)
+
     # Check the groups in a SamInfo structure returned by SamLogon.
     def test_samlogon_SamInfo(self):
         samdb = self.get_samdb()
@@ -27,7 +27,7 @@ from functools import partial
 
 import ldb
 
-from samba import dsdb, ntstatus
+from samba import dsdb, generate_random_password, ntstatus
 
 from samba.dcerpc import krb5pac, security
 
@@ -640,6 +640,55 @@ class KdcTgsTests(KdcTgsBaseTests):
             pac_data.account_sid,
             "rep = {%s},%s" % (rep, pac_data))
 
+    # The KDC may keep the service account lookup for a few seconds, but a
+    # password change must be seen by the very next request.
+    def test_request_after_service_password_change(self):
+        samdb = self.get_samdb()
+
+        client_creds = self.get_client_creds()
+        service_creds = self.get_cached_creds(
+            account_type=self.AccountType.COMPUTER,
+            use_cache=False)
+
+        tgt = self.get_tgt(client_creds)
+        self.get_service_ticket(tgt, service_creds)
+
+        new_password = generate_random_password(32, 32)
+        utf16pw = ('"%s"' % new_password).encode('utf-16-le')
+        self.modify_attribute(samdb, str(service_creds.get_dn()),
+                              'unicodePwd', utf16pw)
+        service_creds.update_password(new_password)
+
+        # The ticket is encrypted with the new key.
+        self.get_service_ticket(tgt, service_creds, fresh=True)
+
+    # The same applies to a change of userAccountControl.
+    def test_request_after_service_uac_change(self):
+        samdb = self.get_samdb()
+
+        client_creds = self.get_client_creds()
+        service_creds = self.get_cached_creds(
+            account_type=self.AccountType.COMPUTER,
+            use_cache=False)
+
+        ok_as_delegate = krb5_asn1.TicketFlags('ok-as-delegate')
+
+        tgt = self.get_tgt(client_creds)
+        self.get_service_ticket(tgt, service_creds,
+                                unexpected_flags=ok_as_delegate)
+
+        res = samdb.search(service_creds.get_dn(),
+                           scope=ldb.SCOPE_BASE,
+                           attrs=['userAccountControl'])
+        uac = int(res[0].get('userAccountControl', idx=0))
+        uac |= dsdb.UF_TRUSTED_FOR_DELEGATION
+        self.modify_attribute(samdb, str(service_creds.get_dn()),
+                              'userAccountControl', str(uac))
+
+        self.get_service_ticket(tgt, service_creds,
+                                expected_flags=ok_as_delegate,
+                                fresh=True)
+
     def test_request(self):
         client_creds = self.get_client_creds()
         service_creds = self.get_service_creds()
@@ -1573,7 +1573,8 @@ sub provision_vampire_dc($$$)
 		$name = "vampire2000dc";
 	} else {
 		$extra_conf = "drs: immediate link sync = yes
-                       drs: max link sync = 250";
+                       drs: max link sync = 250
+                       drs: compress replies = yes";
 	}
 
 	# We do this so that we don't run the provision.  That's the job of 'net vampire'.
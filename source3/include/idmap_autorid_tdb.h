@@ -37,6 +37,8 @@
 #define ALLOC_HWM_GID "NEXT ALLOC GID"
 #define ALLOC_RANGE "ALLOC"
 #define CONFIGKEY "CONFIG"
+/* changed whenever a range is assigned or deleted */
+#define RANGE_SEQNUM "RANGE SEQNUM"
 
 struct autorid_global_config {
 	uint32_t minvalue;
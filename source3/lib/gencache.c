@@ -30,6 +30,7 @@
 #include "zlib.h"
 #include "lib/util/strv.h"
 #include "lib/util/util_paths.h"
+#include "lib/util/memcache.h"
 
 #undef  DBGC_CLASS
 #define DBGC_CLASS DBGC_TDB
@@ -38,6 +39,16 @@
 
 static struct tdb_wrap *cache;
 
+/*
+ * Per-process copy of recently parsed records. gencache.tdb is opened
+ * with TDB_SEQNUM, every store or delete by any process bumps the tdb
+ * sequence number and makes us drop the whole copy. Readers that hit
+ * the copy neither take a chainlock nor touch the shared mmap beyond
+ * the header.
+ */
+static struct memcache *gencache_local;
+static int gencache_local_seqnum;
+
 /**
  * @file gencache.c
  * @brief Generic, persistent and shared between processes cache mechanism
@@ -71,8 +82,10 @@ static bool gencache_init(void)
 {
 	char* cache_fname = NULL;
 	int open_flags = O_RDWR|O_CREAT;
-	int tdb_flags = TDB_INCOMPATIBLE_HASH|TDB_NOSYNC|TDB_MUTEX_LOCKING;
+	int tdb_flags = TDB_INCOMPATIBLE_HASH|TDB_NOSYNC|TDB_MUTEX_LOCKING|
+			TDB_SEQNUM;
 	int hash_size;
+	size_t local_size;
 
 	/* skip file open if it's already opened */
 	if (cache) {
@@ -154,9 +167,52 @@ static bool gencache_init(void)
 	}
 	TALLOC_FREE(cache_fname);
 
+	local_size = lp_parm_ulong(-1, "gencache", "local cache size",
+				   256 * 1024);
+	if (local_size != 0) {
+		gencache_local = memcache_init(cache, local_size);
+		gencache_local_seqnum = tdb_get_seqnum(cache->tdb);
+	}
+
 	return true;
 }
 
+/*
+ * Look up "key" in the per-process copy. A zero-length value records
+ * that the key was not in gencache.tdb, real records are never shorter
+ * than a timeout plus the crc.
+ */
+static bool gencache_local_lookup(TDB_DATA key, int seqnum, DATA_BLOB *data)
+{
+	if (gencache_local == NULL) {
+		return false;
+	}
+	if (seqnum != gencache_local_seqnum) {
+		memcache_flush(gencache_local, GENCACHE_RECORD_CACHE);
+		gencache_local_seqnum = seqnum;
+		return false;
+	}
+	return memcache_lookup(gencache_local,
+			       GENCACHE_RECORD_CACHE,
+			       data_blob_const(key.dptr, key.dsize),
+			       data);
+}
+
+/*
+ * Only called with the tdb seqnum read before the record was parsed,
+ * so a concurrent change will flush this copy on the next lookup.
+ */
+static void gencache_local_store(TDB_DATA key, int seqnum, TDB_DATA data)
+{
+	if ((gencache_local == NULL) || (seqnum != gencache_local_seqnum)) {
+		return;
+	}
+	memcache_add(gencache_local,
+		     GENCACHE_RECORD_CACHE,
+		     data_blob_const(key.dptr, key.dsize),
+		     data_blob_const(data.dptr, data.dsize));
+}
+
 /*
  * Walk the hash chain for "key", deleting all expired entries for
  * that hash chain
@@ -390,6 +446,7 @@ struct gencache_parse_state {
 		       void *private_data);
 	void *private_data;
 	bool format_error;
+	int seqnum;
 };
 
 static int gencache_parse_fn(TDB_DATA key, TDB_DATA data, void *private_data)
@@ -404,6 +461,7 @@ static int gencache_parse_fn(TDB_DATA key, TDB_DATA data, void *private_data)
 		state->format_error = true;
 		return 0;
 	}
+	gencache_local_store(key, state->seqnum, data);
 	state->parser(&t, payload, state->private_data);
 
 	return 0;
@@ -419,6 +477,7 @@ bool gencache_parse(const char *keystr,
 		.parser = parser, .private_data = private_data
 	};
 	TDB_DATA key = string_term_tdb_data(keystr);
+	DATA_BLOB local;
 	int ret;
 
 	if (keystr == NULL) {
@@ -428,11 +487,41 @@ bool gencache_parse(const char *keystr,
 		return false;
 	}
 
+	state.seqnum = tdb_get_seqnum(cache->tdb);
+
+	if (gencache_local_lookup(key, state.seqnum, &local)) {
+		struct gencache_timeout t;
+		DATA_BLOB payload;
+		bool ok;
+
+		if (local.length == 0) {
+			return false;
+		}
+		/*
+		 * As with tdb_parse_record() the parser must not call
+		 * back into gencache, "local" points into the memcache.
+		 */
+		ok = gencache_pull_timeout(
+			key,
+			(TDB_DATA) { .dptr = local.data,
+				     .dsize = local.length },
+			&t.timeout,
+			&payload);
+		if (!ok) {
+			return false;
+		}
+		parser(&t, payload, private_data);
+		return true;
+	}
+
 	ret = tdb_parse_record(cache->tdb, key,
 			       gencache_parse_fn, &state);
 	if ((ret == -1) && (tdb_error(cache->tdb) == TDB_ERR_CORRUPT)) {
 		goto wipe;
 	}
+	if ((ret == -1) && (tdb_error(cache->tdb) == TDB_ERR_NOEXIST)) {
+		gencache_local_store(key, state.seqnum, tdb_null);
+	}
 	if (ret == -1) {
 		return false;
 	}
@@ -882,6 +882,7 @@ static int nfs4_acl_add_sec_ace(bool is_directory,
 				uid_t ownerUID,
 				gid_t ownerGID,
 				const struct security_ace *ace_nt,
+				const struct unixid *trustee_id,
 				struct SMB4ACL_T *nfs4_acl)
 {
 	struct dom_sid_buf buf;
@@ -940,15 +941,7 @@ static int nfs4_acl_add_sec_ace(bool is_directory,
 			return 0;
 		}
 	} else {
-		struct unixid unixid;
-		bool ok;
-
-		ok = sids_to_unixids(&ace_nt->trustee, 1, &unixid);
-		if (!ok) {
-			DBG_WARNING("Could not convert %s to uid or gid.\n",
-				    dom_sid_str_buf(&ace_nt->trustee, &buf));
-			return 0;
-		}
+		struct unixid unixid = *trustee_id;
 
 		if (dom_sid_compare_domain(&ace_nt->trustee,
 					   &global_sid_Unix_NFS) == 0) {
@@ -1086,7 +1079,9 @@ static struct SMB4ACL_T *smbacl4_win2nfs4(
 )
 {
 	struct SMB4ACL_T *theacl;
+	struct unixid *trustee_ids = NULL;
 	uint32_t i;
+	bool ok;
 
 	DEBUG(10, ("smbacl4_win2nfs4 invoked\n"));
 
@@ -1094,17 +1089,37 @@ static struct SMB4ACL_T *smbacl4_win2nfs4(
 	if (theacl==NULL)
 		return NULL;
 
+	/*
+	 * Resolve all trustees with one call into winbindd. In
+	 * nfs4:mode=special the creator SIDs are mapped like any
+	 * other SID.
+	 */
+	trustee_ids = talloc_array(theacl, struct unixid, dacl->num_aces);
+	if (trustee_ids == NULL) {
+		return NULL;
+	}
+	ok = acl_trustees_to_unixids(dacl,
+				     pparams->mode == e_special,
+				     trustee_ids);
+	if (!ok) {
+		DBG_WARNING("Could not convert trustees to uid or gid\n");
+		return NULL;
+	}
+
 	for(i=0; i<dacl->num_aces; i++) {
 		int ret;
 
 		ret = nfs4_acl_add_sec_ace(is_directory, pparams,
 					   ownerUID, ownerGID,
-					   dacl->aces + i, theacl);
+					   dacl->aces + i, trustee_ids + i,
+					   theacl);
 		if (ret == -1) {
 			return NULL;
 		}
 	}
 
+	TALLOC_FREE(trustee_ids);
+
 	if (pparams->mode==e_simple) {
 		smbacl4_substitute_simple(theacl, ownerUID, ownerGID);
 	}
@@ -1580,6 +1580,91 @@ fail:
 	return ret;
 }
 
+/*****************************************************************
+ Map the trustees of all ACEs in an ACL to unix ids with a single
+ sids_to_unixids() call, so a whole ACL costs at most one round trip
+ to winbindd instead of one per ACE. ids[] must have room for
+ acl->num_aces entries, ids[i] is the mapping for acl->aces[i].
+
+ A trustee that is repeated in the ACL is only looked up once. The
+ World SID, and unless map_creator_sids is set the Creator Owner and
+ Creator Group SIDs, are not looked up and are returned as
+ ID_TYPE_NOT_SPECIFIED.
+*****************************************************************/
+
+bool acl_trustees_to_unixids(const struct security_acl *acl,
+			     bool map_creator_sids,
+			     struct unixid *ids)
+{
+	struct dom_sid *sids = NULL;
+	struct unixid *sid_ids = NULL;
+	uint32_t *idx = NULL;
+	uint32_t i, j, num_sids = 0;
+	bool ok;
+
+	if (acl == NULL || acl->num_aces == 0) {
+		return true;
+	}
+
+	sids = talloc_array(talloc_tos(), struct dom_sid, acl->num_aces);
+	idx = talloc_array(sids, uint32_t, acl->num_aces);
+	sid_ids = talloc_array(sids, struct unixid, acl->num_aces);
+	if (sids == NULL || idx == NULL || sid_ids == NULL) {
+		TALLOC_FREE(sids);
+		return false;
+	}
+
+	for (i = 0; i < acl->num_aces; i++) {
+		const struct dom_sid *trustee = &acl->aces[i].trustee;
+
+		ids[i] = (struct unixid) {
+			.id = (uint32_t)-1, .type = ID_TYPE_NOT_SPECIFIED,
+		};
+		idx[i] = UINT32_MAX;
+
+		if (dom_sid_equal(trustee, &global_sid_World)) {
+			continue;
+		}
+		if (!map_creator_sids &&
+		    (dom_sid_equal(trustee, &global_sid_Creator_Owner) ||
+		     dom_sid_equal(trustee, &global_sid_Creator_Group)))
+		{
+			continue;
+		}
+
+		for (j = 0; j < num_sids; j++) {
+			if (dom_sid_equal(trustee, &sids[j])) {
+				break;
+			}
+		}
+		if (j == num_sids) {
+			sid_copy(&sids[num_sids], trustee);
+			num_sids += 1;
+		}
+		idx[i] = j;
+	}
+
+	if (num_sids == 0) {
+		TALLOC_FREE(sids);
+		return true;
+	}
+
+	ok = sids_to_unixids(sids, num_sids, sid_ids);
+	if (!ok) {
+		TALLOC_FREE(sids);
+		return false;
+	}
+
+	for (i = 0; i < acl->num_aces; i++) {
+		if (idx[i] != UINT32_MAX) {
+			ids[i] = sid_ids[idx[i]];
+		}
+	}
+
+	TALLOC_FREE(sids);
+	return true;
+}
+
 /*****************************************************************
  *THE CANONICAL* convert SID to uid function.
 *****************************************************************/
@@ -27,6 +27,7 @@
 
 struct passwd;
 struct unixid;
+struct security_acl;
 
 #define LOOKUP_NAME_NONE		0x00000000
 #define LOOKUP_NAME_ISOLATED             0x00000001  /* Look up unqualified names */
@@ -95,6 +96,9 @@ bool sid_to_uid(const struct dom_sid *psid, uid_t *puid);
 bool sid_to_gid(const struct dom_sid *psid, gid_t *pgid);
 bool sids_to_unixids(const struct dom_sid *sids, uint32_t num_sids,
 		      struct unixid *ids);
+bool acl_trustees_to_unixids(const struct security_acl *acl,
+			     bool map_creator_sids,
+			     struct unixid *ids);
 NTSTATUS get_primary_group_sid(TALLOC_CTX *mem_ctx,
 				const char *username,
 				struct passwd **_pwd,
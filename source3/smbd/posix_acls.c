@@ -1786,6 +1786,7 @@ static bool create_canon_ace_lists(files_struct *fsp,
 	canon_ace *current_ace = NULL;
 	bool got_dir_allow = False;
 	bool got_file_allow = False;
+	struct unixid *unixids = NULL;
 	uint32_t i, j;
 
 	*ppfile_ace = NULL;
@@ -1843,6 +1844,23 @@ static bool create_canon_ace_lists(files_struct *fsp,
 		}
 	}
 
+	/*
+	 * Map all trustees up front, this is one call into winbindd
+	 * for the whole ACL rather than one per ACE.
+	 */
+
+	unixids = talloc_array(talloc_tos(), struct unixid, dacl->num_aces);
+	if (unixids == NULL) {
+		DEBUG(0,("create_canon_ace_lists: malloc fail.\n"));
+		return False;
+	}
+	if (!acl_trustees_to_unixids(dacl, false, unixids)) {
+		DBG_ERR("acl_trustees_to_unixids failed "
+			"(allocation failure)\n");
+		TALLOC_FREE(unixids);
+		return false;
+	}
+
 	for(i = 0; i < dacl->num_aces; i++) {
 		struct security_ace *psa = &dacl->aces[i];
 
@@ -1900,19 +1918,7 @@ static bool create_canon_ace_lists(files_struct *fsp,
 			psa->flags |= SEC_ACE_FLAG_INHERIT_ONLY;
 
 		} else {
-			struct unixid unixid;
-
-			if (!sids_to_unixids(&current_ace->trustee, 1, &unixid)) {
-				struct dom_sid_buf buf;
-				free_canon_ace_list(file_ace);
-				free_canon_ace_list(dir_ace);
-				TALLOC_FREE(current_ace);
-				DBG_ERR("sids_to_unixids failed for %s "
-					"(allocation failure)\n",
-					dom_sid_str_buf(&current_ace->trustee,
-							&buf));
-				return false;
-			}
+			struct unixid unixid = unixids[i];
 
 			if (unixid.type == ID_TYPE_BOTH) {
 				/*
@@ -2066,6 +2072,8 @@ static bool create_canon_ace_lists(files_struct *fsp,
 		}
 	}
 
+	TALLOC_FREE(unixids);
+
 	*ppfile_ace = file_ace;
 	*ppdir_ace = dir_ace;
 
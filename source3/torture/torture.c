@@ -13458,6 +13458,31 @@ static bool run_local_gencache(int dummy)
 		return False;
 	}
 
+	/*
+	 * A miss is remembered in the per-process copy, it must be
+	 * forgotten as soon as the key is stored.
+	 */
+	for (i=0; i<2; i++) {
+		if (gencache_get("foo-miss", NULL, NULL, NULL)) {
+			d_printf("%s: gencache_get() on missing entry "
+				 "succeeded\n", __location__);
+			return False;
+		}
+	}
+	if (!gencache_set("foo-miss", "bar", time(NULL) + 1000)) {
+		d_printf("%s: gencache_set() failed\n", __location__);
+		return False;
+	}
+	if (!gencache_get("foo-miss", NULL, NULL, NULL)) {
+		d_printf("%s: gencache_get() on new entry failed\n",
+			 __location__);
+		return False;
+	}
+	if (!gencache_del("foo-miss")) {
+		d_printf("%s: gencache_del() failed\n", __location__);
+		return False;
+	}
+
 	for (i=0; i<1000000; i++) {
 		gencache_parse("foo", parse_fn, NULL);
 	}
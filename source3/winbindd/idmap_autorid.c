@@ -81,6 +81,7 @@
 #include "libsmb/samlogon_cache.h"
 #include "passdb/machine_sid.h"
 #include "lib/util/string_wrappers.h"
+#include "lib/util/smb_strtox.h"
 
 #undef DBGC_CLASS
 #define DBGC_CLASS DBGC_IDMAP
@@ -92,6 +93,286 @@ static struct db_context *autorid_db;
 
 static bool ignore_builtin = false;
 
+/*
+ * In-memory copy of the range assignments in autorid.tdb, sized by
+ * the ranges actually assigned. by_rangenum is sorted by range number
+ * for id->range, by_sid is sorted by domain SID and range index for
+ * SID->range, both are searched with a binary search.
+ *
+ * The copy is reloaded when RANGE_SEQNUM changes, i.e. when any
+ * process assigned or deleted a range. Plain id mappings in the alloc
+ * range only change the tdb sequence number and don't need a reload.
+ * A range missing from the copy is looked up in the tdb as before, so
+ * the copy can only save lookups, never hide a range.
+ */
+struct autorid_range_entry {
+	struct dom_sid domsid;
+	uint32_t domain_range_index;
+	uint32_t rangenum;
+	bool alloc;
+};
+
+struct autorid_range_table {
+	int seqnum;
+	bool have_range_seqnum;
+	uint32_t range_seqnum;
+	size_t num_ranges;
+	struct autorid_range_entry *by_rangenum;
+	size_t num_sids;
+	struct autorid_range_entry *by_sid;
+};
+
+static struct autorid_range_table *range_table;
+
+static int idmap_autorid_range_entry_cmp(const struct autorid_range_entry *e1,
+					 const struct autorid_range_entry *e2)
+{
+	int cmp;
+
+	cmp = dom_sid_compare(&e1->domsid, &e2->domsid);
+	if (cmp != 0) {
+		return cmp;
+	}
+	return NUMERIC_CMP(e1->domain_range_index, e2->domain_range_index);
+}
+
+static int idmap_autorid_range_entry_num_cmp(
+	const struct autorid_range_entry *e1,
+	const struct autorid_range_entry *e2)
+{
+	return NUMERIC_CMP(e1->rangenum, e2->rangenum);
+}
+
+struct idmap_autorid_range_table_load_state {
+	struct autorid_range_table *table;
+	uint32_t maxranges;
+	size_t num_allocated;
+	bool no_memory;
+};
+
+static int idmap_autorid_range_table_load_fn(struct db_record *rec,
+					     void *private_data)
+{
+	struct idmap_autorid_range_table_load_state *state = private_data;
+	struct autorid_range_table *table = state->table;
+	struct autorid_range_entry entry = { .alloc = false, };
+	TDB_DATA key = dbwrap_record_get_key(rec);
+	TDB_DATA value = dbwrap_record_get_value(rec);
+	const char *q = NULL;
+	int error = 0;
+
+	/*
+	 * Only the "<rangenum>" -> "<domsid>[#<index>]" records are of
+	 * interest, both directions can be built from them.
+	 */
+	if ((key.dsize < 2) || (key.dptr[key.dsize-1] != '\0') ||
+	    !isdigit(key.dptr[0])) {
+		return 0;
+	}
+	entry.rangenum = smb_strtoul((const char *)key.dptr, NULL, 10,
+				     &error, SMB_STR_FULL_STR_CONV);
+	if ((error != 0) || (entry.rangenum >= state->maxranges)) {
+		return 0;
+	}
+	if ((value.dsize == 0) || (value.dptr[value.dsize-1] != '\0')) {
+		return 0;
+	}
+
+	if (strncmp((const char *)value.dptr,
+		    ALLOC_RANGE,
+		    strlen(ALLOC_RANGE)) == 0) {
+		entry.alloc = true;
+		goto add;
+	}
+
+	if (!dom_sid_parse_endp((const char *)value.dptr,
+				&entry.domsid,
+				&q)) {
+		return 0;
+	}
+	switch (*q) {
+	case '\0':
+		entry.domain_range_index = 0;
+		break;
+	case '#':
+		if (sscanf(q+1, "%"SCNu32, &entry.domain_range_index) == 1) {
+			break;
+		}
+		return 0;
+	default:
+		return 0;
+	}
+	table->num_sids += 1;
+
+add:
+	if (table->num_ranges == state->num_allocated) {
+		struct autorid_range_entry *tmp = NULL;
+		size_t num = MAX(state->num_allocated * 2, 16);
+
+		tmp = talloc_realloc(table,
+				     table->by_rangenum,
+				     struct autorid_range_entry,
+				     num);
+		if (tmp == NULL) {
+			state->no_memory = true;
+			return -1;
+		}
+		table->by_rangenum = tmp;
+		state->num_allocated = num;
+	}
+	table->by_rangenum[table->num_ranges++] = entry;
+
+	return 0;
+}
+
+static struct autorid_range_table *idmap_autorid_range_table_get(
+	struct autorid_global_config *cfg)
+{
+	struct idmap_autorid_range_table_load_state state = {
+		.maxranges = cfg->maxranges,
+	};
+	struct autorid_range_table *table = NULL;
+	uint32_t range_seqnum = 0;
+	bool have_range_seqnum;
+	NTSTATUS status;
+	size_t i, j;
+	int seqnum;
+
+	/*
+	 * Read the seqnums before traversing, a range added meanwhile
+	 * makes the next call reload.
+	 */
+	seqnum = dbwrap_get_seqnum(autorid_db);
+
+	if ((range_table != NULL) && (range_table->seqnum == seqnum)) {
+		return range_table;
+	}
+
+	status = dbwrap_fetch_uint32_bystring(autorid_db,
+					      RANGE_SEQNUM,
+					      &range_seqnum);
+	have_range_seqnum = NT_STATUS_IS_OK(status);
+
+	if ((range_table != NULL) && have_range_seqnum &&
+	    range_table->have_range_seqnum &&
+	    (range_table->range_seqnum == range_seqnum)) {
+		/*
+		 * Only id mappings changed
+		 */
+		range_table->seqnum = seqnum;
+		return range_table;
+	}
+	TALLOC_FREE(range_table);
+
+	table = talloc_zero(NULL, struct autorid_range_table);
+	if (table == NULL) {
+		return NULL;
+	}
+	table->seqnum = seqnum;
+	table->have_range_seqnum = have_range_seqnum;
+	table->range_seqnum = range_seqnum;
+	state.table = table;
+
+	status = dbwrap_traverse_read(autorid_db,
+				      idmap_autorid_range_table_load_fn,
+				      &state,
+				      NULL);
+	if (!NT_STATUS_IS_OK(status) || state.no_memory) {
+		DBG_NOTICE("Could not load the range table: %s\n",
+			   state.no_memory ? "no memory" : nt_errstr(status));
+		TALLOC_FREE(table);
+		return NULL;
+	}
+
+	TYPESAFE_QSORT(table->by_rangenum, table->num_ranges,
+		       idmap_autorid_range_entry_num_cmp);
+
+	table->by_sid = talloc_array(table,
+				     struct autorid_range_entry,
+				     table->num_sids);
+	if (table->by_sid == NULL) {
+		TALLOC_FREE(table);
+		return NULL;
+	}
+	for (i = 0, j = 0; i < table->num_ranges; i++) {
+		struct autorid_range_entry *e = &table->by_rangenum[i];
+
+		if (!e->alloc) {
+			table->by_sid[j++] = *e;
+		}
+	}
+	TYPESAFE_QSORT(table->by_sid, table->num_sids,
+		       idmap_autorid_range_entry_cmp);
+
+	DBG_DEBUG("Loaded %zu ranges, %zu domain ranges\n",
+		  table->num_ranges, table->num_sids);
+
+	range_table = table;
+	return range_table;
+}
+
+static const struct autorid_range_entry *idmap_autorid_range_by_rangenum(
+	const struct autorid_range_table *table,
+	uint32_t rangenum)
+{
+	size_t lo = 0, hi;
+
+	if (table == NULL) {
+		return NULL;
+	}
+
+	hi = table->num_ranges;
+	while (lo < hi) {
+		size_t mid = lo + (hi - lo) / 2;
+		const struct autorid_range_entry *e = &table->by_rangenum[mid];
+
+		if (e->rangenum == rangenum) {
+			return e;
+		}
+		if (rangenum < e->rangenum) {
+			hi = mid;
+		} else {
+			lo = mid + 1;
+		}
+	}
+
+	return NULL;
+}
+
+static const struct autorid_range_entry *idmap_autorid_range_by_sid(
+	const struct autorid_range_table *table,
+	const struct dom_sid *domsid,
+	uint32_t domain_range_index)
+{
+	struct autorid_range_entry key = {
+		.domain_range_index = domain_range_index,
+	};
+	size_t lo = 0, hi;
+
+	if (table == NULL) {
+		return NULL;
+	}
+	sid_copy(&key.domsid, domsid);
+
+	hi = table->num_sids;
+	while (lo < hi) {
+		size_t mid = lo + (hi - lo) / 2;
+		int cmp = idmap_autorid_range_entry_cmp(&key,
+							&table->by_sid[mid]);
+
+		if (cmp == 0) {
+			return &table->by_sid[mid];
+		}
+		if (cmp < 0) {
+			hi = mid;
+		} else {
+			lo = mid + 1;
+		}
+	}
+
+	return NULL;
+}
+
 static NTSTATUS idmap_autorid_get_alloc_range(struct idmap_domain *dom,
 					struct autorid_range_config *range)
 {
@@ -168,9 +449,11 @@ static NTSTATUS idmap_autorid_id_to_sid_alloc(struct idmap_domain *dom,
 }
 
 static NTSTATUS idmap_autorid_id_to_sid(struct autorid_global_config *cfg,
+					const struct autorid_range_table *table,
 					struct idmap_domain *dom,
 					struct id_map *map)
 {
+	const struct autorid_range_entry *entry = NULL;
 	uint32_t range_number;
 	uint32_t domain_range_index;
 	uint32_t normalized_id;
@@ -203,6 +486,16 @@ static NTSTATUS idmap_autorid_id_to_sid(struct autorid_global_config *cfg,
 	normalized_id = map->xid.id - cfg->minvalue;
 	range_number = normalized_id / cfg->rangesize;
 
+	entry = idmap_autorid_range_by_rangenum(table, range_number);
+	if (entry != NULL) {
+		if (entry->alloc) {
+			return idmap_autorid_id_to_sid_alloc(dom, map);
+		}
+		sid_copy(&domsid, &entry->domsid);
+		domain_range_index = entry->domain_range_index;
+		goto compose;
+	}
+
 	keystr = talloc_asprintf(talloc_tos(), "%u", range_number);
 	if (!keystr) {
 		return NT_STATUS_NO_MEMORY;
@@ -272,6 +565,7 @@ static NTSTATUS idmap_autorid_id_to_sid(struct autorid_global_config *cfg,
 
 	TALLOC_FREE(data.dptr);
 
+compose:
 	reduced_rid = normalized_id % cfg->rangesize;
 	rid = reduced_rid + domain_range_index * cfg->rangesize;
 
@@ -319,6 +613,7 @@ static NTSTATUS idmap_autorid_unixids_to_sids(struct idmap_domain *dom,
 {
 	struct idmap_tdb_common_context *commoncfg;
 	struct autorid_global_config *globalcfg;
+	struct autorid_range_table *table;
 	NTSTATUS ret;
 	int i;
 	int num_tomap = 0;
@@ -337,9 +632,11 @@ static NTSTATUS idmap_autorid_unixids_to_sids(struct idmap_domain *dom,
 	globalcfg = talloc_get_type(commoncfg->private_data,
 				    struct autorid_global_config);
 
+	table = idmap_autorid_range_table_get(globalcfg);
+
 	for (i = 0; ids[i]; i++) {
 
-		ret = idmap_autorid_id_to_sid(globalcfg, dom, ids[i]);
+		ret = idmap_autorid_id_to_sid(globalcfg, table, dom, ids[i]);
 
 		if ((!NT_STATUS_IS_OK(ret)) &&
 		    (!NT_STATUS_EQUAL(ret, NT_STATUS_NONE_MAPPED))) {
@@ -542,12 +839,14 @@ static bool idmap_autorid_domsid_is_for_alloc(struct dom_sid *sid)
 }
 
 static NTSTATUS idmap_autorid_sid_to_id(struct idmap_tdb_common_context *common,
+					const struct autorid_range_table *table,
 					struct idmap_domain *dom,
 					struct id_map *map)
 {
 	struct autorid_global_config *global =
 		talloc_get_type_abort(common->private_data,
 				      struct autorid_global_config);
+	const struct autorid_range_entry *entry = NULL;
 	struct autorid_range_config range;
 	uint32_t rid;
 	struct dom_sid domainsid;
@@ -581,10 +880,19 @@ static NTSTATUS idmap_autorid_sid_to_id(struct idmap_tdb_common_context *common,
 		return NT_STATUS_NONE_MAPPED;
 	}
 
-	sid_to_fstring(range.domsid, &domainsid);
-
 	range.domain_range_index = rid / (global->rangesize);
 
+	entry = idmap_autorid_range_by_sid(table, &domainsid,
+					   range.domain_range_index);
+	if (entry != NULL) {
+		return idmap_autorid_sid_to_id_rid(
+			global->rangesize,
+			global->minvalue + entry->rangenum * global->rangesize,
+			map);
+	}
+
+	sid_to_fstring(range.domsid, &domainsid);
+
 	ret = idmap_autorid_getrange(autorid_db, range.domsid,
 				     range.domain_range_index,
 				     &range.rangenum, &range.low_id);
@@ -696,6 +1004,7 @@ static NTSTATUS idmap_autorid_sids_to_unixids(struct idmap_domain *dom,
 					      struct id_map **ids)
 {
 	struct idmap_tdb_common_context *commoncfg;
+	struct autorid_range_table *table;
 	NTSTATUS ret;
 	size_t i;
 	size_t num_tomap = 0;
@@ -712,8 +1021,12 @@ static NTSTATUS idmap_autorid_sids_to_unixids(struct idmap_domain *dom,
 	    talloc_get_type_abort(dom->private_data,
 				  struct idmap_tdb_common_context);
 
+	table = idmap_autorid_range_table_get(
+		talloc_get_type_abort(commoncfg->private_data,
+				      struct autorid_global_config));
+
 	for (i = 0; ids[i]; i++) {
-		ret = idmap_autorid_sid_to_id(commoncfg, dom, ids[i]);
+		ret = idmap_autorid_sid_to_id(commoncfg, table, dom, ids[i]);
 		if (NT_STATUS_EQUAL(ret, NT_STATUS_SOME_NOT_MAPPED) &&
 		    ids[i]->status == ID_REQUIRE_TYPE)
 		{
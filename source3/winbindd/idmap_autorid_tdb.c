@@ -79,6 +79,18 @@ struct idmap_autorid_addrange_ctx {
 	bool acquire;
 };
 
+/*
+ * Tell the readers of the range assignments that they changed,
+ * see RANGE_SEQNUM.
+ */
+static NTSTATUS idmap_autorid_bump_range_seqnum(struct db_context *db)
+{
+	uint32_t seqnum = 0;
+
+	return dbwrap_change_uint32_atomic_bystring(db, RANGE_SEQNUM,
+						    &seqnum, 1);
+}
+
 static NTSTATUS idmap_autorid_addrange_action(struct db_context *db,
 					      void *private_data)
 {
@@ -269,6 +281,13 @@ static NTSTATUS idmap_autorid_addrange_action(struct db_context *db,
 		goto error;
 	}
 
+	ret = idmap_autorid_bump_range_seqnum(db);
+	if (!NT_STATUS_IS_OK(ret)) {
+		DEBUG(1, ("Fatal error while updating the range "
+			  "sequence number: %s\n", nt_errstr(ret)));
+		goto error;
+	}
+
 	DEBUG(5, ("%s new range #%d for domain %s "
 		  "(domain_range_index=%"PRIu32")\n",
 		  (acquire?"Acquired":"Stored"),
@@ -568,6 +587,13 @@ static NTSTATUS idmap_autorid_delete_range_by_sid_action(struct db_context *db,
 		goto done;
 	}
 
+	status = idmap_autorid_bump_range_seqnum(db);
+	if (!NT_STATUS_IS_OK(status)) {
+		DEBUG(1, ("Updating the range sequence number failed: %s\n",
+			  nt_errstr(status)));
+		goto done;
+	}
+
 	if (!is_valid_range_mapping) {
 		goto done;
 	}
@@ -690,6 +716,13 @@ static NTSTATUS idmap_autorid_delete_range_by_num_action(struct db_context *db,
 		goto done;
 	}
 
+	status = idmap_autorid_bump_range_seqnum(db);
+	if (!NT_STATUS_IS_OK(status)) {
+		DEBUG(1, ("Updating the range sequence number failed: %s\n",
+			  nt_errstr(status)));
+		goto done;
+	}
+
 	if (!is_valid_range_mapping) {
 		goto done;
 	}
@@ -737,7 +770,7 @@ NTSTATUS idmap_autorid_db_open(const char *path,
 	}
 
 	/* Open idmap repository */
-	*db = db_open(mem_ctx, path, 0, TDB_DEFAULT, O_RDWR | O_CREAT, 0644,
+	*db = db_open(mem_ctx, path, 0, TDB_SEQNUM, O_RDWR | O_CREAT, 0644,
 		      DBWRAP_LOCK_ORDER_1, DBWRAP_FLAG_NONE);
 
 	if (*db == NULL) {
@@ -23,6 +23,7 @@
 #include "librpc/gen_ndr/ndr_winbind_c.h"
 #include "../libcli/security/security.h"
 #include "passdb/machine_sid.h"
+#include "lib/util/memcache.h"
 
 struct wb_gettoken_state {
 	struct tevent_context *ev;
@@ -30,8 +31,135 @@ struct wb_gettoken_state {
 	bool expand_local_aliases;
 	uint32_t num_sids;
 	struct dom_sid *sids;
+	bool partial;
+	bool cached;
+	struct timeval start;
 };
 
+/*
+ * Expanded tokens, keyed by user SID and expand_local_aliases. smbd
+ * session setups come in through wbcGetGroups() and friends, so they
+ * share this cache with the nss and pam calls. Entries live for
+ * "winbind:token cache ttl" seconds and are dropped on a config
+ * reload via winbindd_flush_caches(). Like the winbindd cache, it is
+ * not used when winbindd runs with caching disabled (-n).
+ */
+
+static struct memcache *wb_gettoken_cache;
+
+struct wb_gettoken_cache_hdr {
+	time_t expires;
+	uint32_t num_sids;
+};
+
+static struct {
+	uint64_t hits;
+	uint64_t misses;
+	uint64_t build_usecs;
+	uint64_t max_build_usecs;
+} wb_gettoken_stats;
+
+static DATA_BLOB wb_gettoken_cache_key(struct wb_gettoken_state *state,
+				       uint8_t *buf, size_t buflen)
+{
+	size_t len = ndr_size_dom_sid(&state->usersid, 0);
+
+	if (!sid_linearize(buf, buflen - 1, &state->usersid)) {
+		return data_blob_null;
+	}
+	buf[len] = state->expand_local_aliases ? 1 : 0;
+
+	return data_blob_const(buf, len + 1);
+}
+
+static bool wb_gettoken_cache_fetch(struct wb_gettoken_state *state)
+{
+	uint8_t keybuf[sizeof(struct dom_sid) + 1];
+	struct wb_gettoken_cache_hdr hdr;
+	DATA_BLOB key, value;
+
+	if (!winbindd_use_cache() || (wb_gettoken_cache == NULL)) {
+		return false;
+	}
+	key = wb_gettoken_cache_key(state, keybuf, sizeof(keybuf));
+	if (key.length == 0) {
+		return false;
+	}
+	if (!memcache_lookup(wb_gettoken_cache, WB_GETTOKEN_CACHE,
+			     key, &value)) {
+		return false;
+	}
+	if (value.length < sizeof(hdr)) {
+		return false;
+	}
+	memcpy(&hdr, value.data, sizeof(hdr));
+
+	if ((hdr.expires <= time(NULL)) ||
+	    (value.length != sizeof(hdr) +
+			     hdr.num_sids * sizeof(struct dom_sid))) {
+		memcache_delete(wb_gettoken_cache, WB_GETTOKEN_CACHE, key);
+		return false;
+	}
+
+	state->sids = talloc_memdup(state, value.data + sizeof(hdr),
+				    hdr.num_sids * sizeof(struct dom_sid));
+	if (state->sids == NULL) {
+		return false;
+	}
+	talloc_set_name_const(state->sids, "struct dom_sid");
+	state->num_sids = hdr.num_sids;
+
+	return true;
+}
+
+static void wb_gettoken_cache_store(struct wb_gettoken_state *state)
+{
+	int ttl = lp_parm_int(-1, "winbind", "token cache ttl", 60);
+	uint8_t keybuf[sizeof(struct dom_sid) + 1];
+	struct wb_gettoken_cache_hdr hdr;
+	DATA_BLOB key, value;
+	size_t sids_len;
+
+	if (!winbindd_use_cache() || (ttl <= 0) || state->partial) {
+		return;
+	}
+
+	if (wb_gettoken_cache == NULL) {
+		wb_gettoken_cache = memcache_init(
+			NULL,
+			lp_parm_ulong(-1, "winbind", "token cache size",
+				      1024 * 1024));
+		if (wb_gettoken_cache == NULL) {
+			return;
+		}
+	}
+
+	key = wb_gettoken_cache_key(state, keybuf, sizeof(keybuf));
+	if (key.length == 0) {
+		return;
+	}
+
+	sids_len = state->num_sids * sizeof(struct dom_sid);
+	value = data_blob_talloc(state, NULL, sizeof(hdr) + sids_len);
+	if (value.data == NULL) {
+		return;
+	}
+	hdr = (struct wb_gettoken_cache_hdr) {
+		.expires = time(NULL) + ttl,
+		.num_sids = state->num_sids,
+	};
+	memcpy(value.data, &hdr, sizeof(hdr));
+	memcpy(value.data + sizeof(hdr), state->sids, sids_len);
+
+	memcache_add(wb_gettoken_cache, WB_GETTOKEN_CACHE, key, value);
+	data_blob_free(&value);
+}
+
+void wb_gettoken_cache_flush(void)
+{
+	TALLOC_FREE(wb_gettoken_cache);
+}
+
 static NTSTATUS wb_add_rids_to_sids(TALLOC_CTX *mem_ctx,
 				    uint32_t *pnum_sids,
 				    struct dom_sid **psids,
@@ -61,11 +189,23 @@ struct tevent_req *wb_gettoken_send(TALLOC_CTX *mem_ctx,
 	sid_copy(&state->usersid, sid);
 	state->ev = ev;
 	state->expand_local_aliases = expand_local_aliases;
+	state->start = timeval_current();
 
 	D_INFO("WB command gettoken start.\n"
 	       "Query user SID %s (expand local aliases is %d).\n",
 	       dom_sid_str_buf(sid, &buf),
 	       expand_local_aliases);
+
+	if (wb_gettoken_cache_fetch(state)) {
+		wb_gettoken_stats.hits += 1;
+		state->cached = true;
+		D_DEBUG("Found %"PRIu32" SID(s) in the token cache.\n",
+			state->num_sids);
+		tevent_req_done(req);
+		return tevent_req_post(req, ev);
+	}
+	wb_gettoken_stats.misses += 1;
+
 	subreq = wb_queryuser_send(state, ev, &state->usersid);
 	if (tevent_req_nomem(subreq, req)) {
 		return tevent_req_post(req, ev);
@@ -124,6 +264,8 @@ static void wb_gettoken_gotgroups(struct tevent_req *subreq)
 	status = wb_lookupusergroups_recv(subreq, state, &num_groups, &groups);
 	TALLOC_FREE(subreq);
 	if (!NT_STATUS_IS_OK(status)) {
+		/* don't cache a token without the user's groups */
+		state->partial = true;
 		tevent_req_done(req);
 		return;
 	}
@@ -263,6 +405,28 @@ NTSTATUS wb_gettoken_recv(struct tevent_req *req, TALLOC_CTX *mem_ctx,
 	if (tevent_req_is_nterror(req, &status)) {
 		return status;
 	}
+
+	if (!state->cached) {
+		struct timeval now = timeval_current();
+		uint64_t usecs = usec_time_diff(&now, &state->start);
+
+		wb_gettoken_stats.build_usecs += usecs;
+		wb_gettoken_stats.max_build_usecs = MAX(
+			wb_gettoken_stats.max_build_usecs, usecs);
+		D_INFO("Token built in %"PRIu64" usec. Token cache: "
+		       "%"PRIu64" hits, %"PRIu64" misses, "
+		       "%"PRIu64" usec average / %"PRIu64" usec max "
+		       "build time.\n",
+		       usecs,
+		       wb_gettoken_stats.hits,
+		       wb_gettoken_stats.misses,
+		       wb_gettoken_stats.build_usecs /
+		       wb_gettoken_stats.misses,
+		       wb_gettoken_stats.max_build_usecs);
+
+		wb_gettoken_cache_store(state);
+	}
+
 	*num_sids = state->num_sids;
 	D_INFO("WB command gettoken end.\nReceived %"PRIu32" SID(s).\n",
 	       state->num_sids);
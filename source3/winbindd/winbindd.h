@@ -201,8 +201,13 @@ struct winbindd_domain {
 	struct winbindd_child *children;
 
 	struct tevent_queue *queue;
+	struct tevent_queue *prio_queue; /* interactive logons */
+	bool initializing; /* a queued request runs InitConnection */
 	struct dcerpc_binding_handle *binding_handle;
 
+	uint32_t num_logons_inflight;
+	uint32_t max_logons_inflight;
+
 	struct tevent_req *check_online_event;
 
 	/* Linked list info */
@@ -103,6 +103,8 @@ void winbindd_flush_caches(void)
 			exit(1);
 		}
 	}
+
+	wb_gettoken_cache_flush();
 }
 
 /************************************************************************
@@ -596,6 +598,68 @@ done:
 	return;
 }
 
+/*
+  the lifetime of a cache entry. "winbind cache ttl:<type>" overrides
+  "winbind cache time" for one type of entry. The type is the key
+  prefix for centries ("U", "UG", "GM", ...) and the wbint call name
+  for NDR entries ("wbint_LookupSid", "wbint_LookupUserGroups", ...)
+*/
+static int wcache_type_ttl(const char *type)
+{
+	return lp_parm_int(-1, "winbind cache ttl", type,
+			   lp_winbind_cache_time());
+}
+
+static int wcache_centry_ttl(const char *keystr)
+{
+	char type[32];
+	const char *p = strchr(keystr, '/');
+	size_t len = (p != NULL) ? PTR_DIFF(p, keystr) : strlen(keystr);
+
+	if (len >= sizeof(type)) {
+		return lp_winbind_cache_time();
+	}
+	memcpy(type, keystr, len);
+	type[len] = '\0';
+
+	return wcache_type_ttl(type);
+}
+
+static int wcache_ndr_ttl(uint32_t opnum)
+{
+	if (opnum >= ndr_table_winbind.num_calls) {
+		return lp_winbind_cache_time();
+	}
+	return wcache_type_ttl(ndr_table_winbind.calls[opnum].name);
+}
+
+/*
+  refresh-ahead: during the last "winbind cache:refresh ahead" percent
+  of an entry's lifetime report it as a miss, with a probability that
+  rises to 1 at expiry. Only entries looked up in that window are
+  refreshed, so hot entries are replaced before they expire while cold
+  ones simply age out, and concurrent lookups of one hot entry don't
+  all miss at the same moment.
+*/
+static bool wcache_refresh_ahead(uint64_t timeout, int ttl)
+{
+	int pct = lp_parm_int(-1, "winbind cache", "refresh ahead", 10);
+	time_t now = time(NULL);
+	uint64_t window, remaining;
+
+	if ((pct <= 0) || (ttl <= 0) || ((time_t)timeout <= now)) {
+		return false;
+	}
+
+	window = (uint64_t)ttl * MIN(pct, 100) / 100;
+	remaining = timeout - now;
+	if (remaining >= window) {
+		return false;
+	}
+
+	return (generate_random() % window) >= remaining;
+}
+
 /*
   decide if a cache entry has expired
 */
@@ -626,11 +690,12 @@ static bool centry_expired(struct winbindd_domain *domain, const char *keystr, s
 		return true;
 	}
 
-	/* if the server is down or the cache entry is not older than the
-	   current sequence number or it did not timeout then it is OK */
+	/* if the server is down or the cache entry did not timeout then
+	   it is OK. The domain sequence number is only the time of the
+	   last check, comparing it would expire every entry at once each
+	   "winbind cache time" seconds regardless of its own timeout. */
 	if (wcache_server_down(domain)
-	    || ((centry->sequence_number == domain->sequence_number)
-		&& ((time_t)centry->timeout > time(NULL)))) {
+	    || ((time_t)centry->timeout > time(NULL))) {
 		DBG_DEBUG("centry_expired: Key %s for domain %s is good.\n",
 			keystr, domain->name );
 		return false;
@@ -744,6 +809,17 @@ static struct cache_entry *wcache_fetch(struct winbind_cache *cache,
 		return NULL;
 	}
 
+	if (domain->online && !wcache_server_down(domain) &&
+	    wcache_refresh_ahead(centry->timeout, wcache_centry_ttl(kstr))) {
+
+		DBG_DEBUG("wcache_fetch: refreshing entry %s for domain %s "
+			  "ahead of expiry\n", kstr, domain->name);
+
+		centry_free(centry);
+		free(kstr);
+		return NULL;
+	}
+
 	DBG_DEBUG("wcache_fetch: returning entry %s for domain %s\n",
 		 kstr, domain->name );
 
@@ -952,6 +1028,10 @@ static void centry_end(struct cache_entry *centry, const char *format, ...)
 		return;
 	}
 
+	/* apply the per-type lifetime, centry_start() used the default */
+	centry->timeout = time(NULL) + wcache_centry_ttl(kstr);
+	SBVAL(centry->data, 8, centry->timeout);
+
 	key = string_tdb_data(kstr);
 	data.dptr = centry->data;
 	data.dsize = centry->ofs;
@@ -4850,8 +4930,14 @@ bool wcache_fetch_ndr(TALLOC_CTX *mem_ctx, struct winbindd_domain *domain,
 					 &last_check)) {
 			goto fail;
 		}
+		/*
+		 * Entries stored while the server was down are
+		 * invalid once it is back, otherwise the entry
+		 * timeout alone decides, see centry_expired().
+		 */
 		entry_seqnum = IVAL(data.dptr, 0);
-		if (entry_seqnum != dom_seqnum) {
+		if ((entry_seqnum == DOM_SEQUENCE_NONE) &&
+		    (dom_seqnum != DOM_SEQUENCE_NONE)) {
 			DBG_DEBUG("Entry has wrong sequence number: %d\n",
 				   (int)entry_seqnum);
 			goto fail;
@@ -4861,6 +4947,11 @@ bool wcache_fetch_ndr(TALLOC_CTX *mem_ctx, struct winbindd_domain *domain,
 			DBG_DEBUG("Entry has timed out\n");
 			goto fail;
 		}
+		if (wcache_refresh_ahead(entry_timeout,
+					 wcache_ndr_ttl(opnum))) {
+			DBG_DEBUG("Refreshing entry ahead of expiry\n");
+			goto fail;
+		}
 	}
 
 	resp->data = (uint8_t *)talloc_memdup(mem_ctx, data.dptr + 12,
@@ -4904,7 +4995,7 @@ void wcache_store_ndr(struct winbindd_domain *domain, uint32_t opnum,
 		return;
 	}
 
-	timeout = time(NULL) + lp_winbind_cache_time();
+	timeout = time(NULL) + wcache_ndr_ttl(opnum);
 
 	data.dsize = resp->length + 12;
 	data.dptr = talloc_array(key.dptr, uint8_t, data.dsize);
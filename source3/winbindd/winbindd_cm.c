@@ -1507,9 +1507,18 @@ static bool connect_preferred_dc(TALLOC_CTX *mem_ctx,
 		return false;
 	}
 
+	/*
+	 * A reachable DC accepts the connection within milliseconds.
+	 * Don't let an unreachable preferred DC, e.g. one down for
+	 * maintenance, hold up the failover to the other DCs in
+	 * find_dc() for the full 10 seconds.
+	 */
 	status = smbsock_connect(&domain->dcaddr, 0,
 				 domain->dcname, -1, NULL, -1,
-				 fd, NULL, 10);
+				 fd, NULL,
+				 lp_parm_int(-1, "winbind",
+					     "preferred dc connect timeout",
+					     3));
 	if (!NT_STATUS_IS_OK(status)) {
 		winbind_add_failed_connection_entry(domain,
 						    domain->dcname,
@@ -306,6 +306,36 @@ static void wb_child_request_done(struct tevent_req *subreq)
 	tevent_req_done(req);
 }
 
+/*
+ * Interactive logons go to a separate per-domain queue that is always
+ * served first, so a burst of directory lookups or network logons
+ * does not delay users sitting in front of a login prompt.
+ */
+static bool wb_domain_request_is_prio(const struct winbindd_request *request)
+{
+	return (request->cmd == WINBINDD_DUAL_NDRCMD) &&
+	       (request->data.ndrcmd == NDR_WBINT_PAMAUTH);
+}
+
+static bool wb_domain_request_is_logon(const struct winbindd_request *request)
+{
+	if (request->cmd != WINBINDD_DUAL_NDRCMD) {
+		return false;
+	}
+	return (request->data.ndrcmd == NDR_WBINT_PAMAUTH) ||
+	       (request->data.ndrcmd == NDR_WBINT_PAMAUTHCRAP);
+}
+
+static void wb_domain_queues_start(struct winbindd_domain *domain)
+{
+	/*
+	 * Start the priority queue first, its trigger is scheduled
+	 * first and gets the chance to grab an idle child.
+	 */
+	tevent_queue_start(domain->prio_queue);
+	tevent_queue_start(domain->queue);
+}
+
 static void wb_child_request_orphaned(struct tevent_req *subreq)
 {
 	struct winbindd_child *child =
@@ -321,7 +351,7 @@ static void wb_child_request_orphaned(struct tevent_req *subreq)
 		 * can move forward, after the orphaned
 		 * request is done.
 		 */
-		tevent_queue_start(child->domain->queue);
+		wb_domain_queues_start(child->domain);
 	}
 }
 
@@ -384,7 +414,7 @@ static void wb_child_request_cleanup(struct tevent_req *req,
 		 * can move forward, after the request
 		 * is done.
 		 */
-		tevent_queue_start(state->child->domain->queue);
+		wb_domain_queues_start(state->child->domain);
 	}
 
 	if (req_state == TEVENT_REQ_DONE) {
@@ -428,9 +458,17 @@ static void child_socket_readable(struct tevent_context *ev,
 	child->sock = -1;
 }
 
+/*
+ * Pick the child for the next request to a domain. An idle child that
+ * is already running is preferred, as it most likely has its DC
+ * connection set up already. Only if there is none do we use an idle
+ * child that still needs to be forked and connect to a DC, which can
+ * take much longer than waiting for the request at hand.
+ */
 static struct winbindd_child *choose_domain_child(struct winbindd_domain *domain)
 {
 	struct winbindd_child *shortest = &domain->children[0];
+	struct winbindd_child *idle = NULL;
 	struct winbindd_child *current;
 	int i;
 
@@ -442,7 +480,13 @@ static struct winbindd_child *choose_domain_child(struct winbindd_domain *domain
 
 		if (current_len == 0) {
 			/* idle child */
-			return current;
+			if (current->sock != -1) {
+				return current;
+			}
+			if (idle == NULL) {
+				idle = current;
+			}
+			continue;
 		}
 
 		shortest_len = tevent_queue_length(shortest->queue);
@@ -452,6 +496,10 @@ static struct winbindd_child *choose_domain_child(struct winbindd_domain *domain
 		}
 	}
 
+	if (idle != NULL) {
+		return idle;
+	}
+
 	return shortest;
 }
 
@@ -474,9 +522,17 @@ struct wb_domain_request_state {
 	 * struct winbindd_child *child
 	 * does not be come invalid.
 	 */
+	struct tevent_queue *queue;
 	struct tevent_queue_entry *queue_entry;
 	struct winbindd_domain *domain; /* no ref needed */
+	/*
+	 * Logons are counted until the child answered,
+	 * long after we left the domain queue.
+	 */
+	struct winbindd_domain_ref logon_domain;
+	bool logon_counted;
 	struct winbindd_child *child;
+	bool initializing;
 	struct winbindd_request *request;
 	struct winbindd_request *init_req;
 	struct winbindd_response *response;
@@ -490,6 +546,19 @@ static void wb_domain_request_cleanup(struct tevent_req *req,
 	struct wb_domain_request_state *state = tevent_req_data(
 		req, struct wb_domain_request_state);
 
+	if (state->logon_counted) {
+		struct winbindd_domain *domain = NULL;
+		bool valid;
+
+		state->logon_counted = false;
+
+		valid = winbindd_domain_ref_get(&state->logon_domain,
+						&domain);
+		if (valid && domain->num_logons_inflight > 0) {
+			domain->num_logons_inflight -= 1;
+		}
+	}
+
 	/*
 	 * If we're completely done or got a failure.
 	 * we should remove ourself from the domain queue,
@@ -500,7 +569,11 @@ static void wb_domain_request_cleanup(struct tevent_req *req,
 	state->child = NULL;
 	TALLOC_FREE(state->pending_subreq);
 	if (state->domain != NULL) {
-		tevent_queue_start(state->domain->queue);
+		if (state->initializing) {
+			state->domain->initializing = false;
+			state->initializing = false;
+		}
+		wb_domain_queues_start(state->domain);
 		state->domain = NULL;
 	}
 	TALLOC_FREE(state->queue_entry);
@@ -532,13 +605,36 @@ struct tevent_req *wb_domain_request_send(TALLOC_CTX *mem_ctx,
 
 	tevent_req_set_cleanup_fn(req, wb_domain_request_cleanup);
 
+	state->queue = domain->queue;
+	if (wb_domain_request_is_prio(request)) {
+		state->queue = domain->prio_queue;
+	}
+
 	state->queue_entry = tevent_queue_add_entry(
-			domain->queue, state->ev, req,
+			state->queue, state->ev, req,
 			wb_domain_request_trigger, NULL);
 	if (tevent_req_nomem(state->queue_entry, req)) {
 		return tevent_req_post(req, ev);
 	}
 
+	if (wb_domain_request_is_logon(request)) {
+		winbindd_domain_ref_set(&state->logon_domain, domain);
+		state->logon_counted = true;
+
+		domain->num_logons_inflight += 1;
+		domain->max_logons_inflight = MAX(domain->max_logons_inflight,
+						  domain->num_logons_inflight);
+
+		DBG_DEBUG("domain[%s] logons in flight: %"PRIu32" "
+			  "(max %"PRIu32"), priority queue: %zu, "
+			  "queue: %zu\n",
+			  domain->name,
+			  domain->num_logons_inflight,
+			  domain->max_logons_inflight,
+			  tevent_queue_length(domain->prio_queue),
+			  tevent_queue_length(domain->queue));
+	}
+
 	return req;
 }
 
@@ -551,6 +647,30 @@ static void wb_domain_request_trigger(struct tevent_req *req,
 	struct tevent_req *subreq = NULL;
 	size_t shortest_queue_length;
 
+	if ((state->queue != domain->prio_queue) &&
+	    (tevent_queue_length(domain->prio_queue) > 0)) {
+		/*
+		 * Interactive logons are waiting, let them
+		 * have the next idle child. We get retriggered
+		 * once they left the priority queue.
+		 */
+		tevent_queue_stop(state->queue);
+		tevent_queue_entry_untrigger(state->queue_entry);
+		return;
+	}
+
+	if (!domain->initialized && domain->initializing) {
+		/*
+		 * The head of the other queue is already
+		 * initializing the domain and may use the
+		 * child we would choose. We get retriggered
+		 * once it is done.
+		 */
+		tevent_queue_stop(state->queue);
+		tevent_queue_entry_untrigger(state->queue_entry);
+		return;
+	}
+
 	state->child = choose_domain_child(domain);
 	shortest_queue_length = tevent_queue_length(state->child->queue);
 	if (shortest_queue_length > 0) {
@@ -562,7 +682,7 @@ static void wb_domain_request_trigger(struct tevent_req *req,
 		 * and we get retriggered.
 		 */
 		state->child = NULL;
-		tevent_queue_stop(state->domain->queue);
+		tevent_queue_stop(state->queue);
 		tevent_queue_entry_untrigger(state->queue_entry);
 		return;
 	}
@@ -584,7 +704,7 @@ static void wb_domain_request_trigger(struct tevent_req *req,
 		 * to check for an idle child.
 		 */
 		state->child = NULL;
-		tevent_queue_start(state->domain->queue);
+		wb_domain_queues_start(state->domain);
 		state->domain = NULL;
 		TALLOC_FREE(state->queue_entry);
 		return;
@@ -595,6 +715,9 @@ static void wb_domain_request_trigger(struct tevent_req *req,
 		return;
 	}
 
+	domain->initializing = true;
+	state->initializing = true;
+
 	if (IS_DC || domain->primary || domain->internal) {
 		/* The primary domain has to find the DC name itself */
 		state->r.in.dcname = talloc_strdup(state, "");
@@ -723,6 +846,8 @@ static void wb_domain_request_initialized(struct tevent_req *subreq)
 	state->domain->active_directory =
 			(*state->r.out.flags & WB_DOMINFO_DOMAIN_AD);
 	state->domain->initialized = true;
+	state->domain->initializing = false;
+	state->initializing = false;
 
 	subreq = wb_child_request_send(state, state->ev, state->child,
 				       state->request);
@@ -740,7 +865,7 @@ static void wb_domain_request_initialized(struct tevent_req *subreq)
 	 * to check for an idle child.
 	 */
 	state->child = NULL;
-	tevent_queue_start(state->domain->queue);
+	wb_domain_queues_start(state->domain);
 	state->domain = NULL;
 	TALLOC_FREE(state->queue_entry);
 }
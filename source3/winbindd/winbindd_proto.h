@@ -734,6 +734,7 @@ struct tevent_req *wb_gettoken_send(TALLOC_CTX *mem_ctx,
 				    bool expand_local_aliases);
 NTSTATUS wb_gettoken_recv(struct tevent_req *req, TALLOC_CTX *mem_ctx,
 			  uint32_t *num_sids, struct dom_sid **sids);
+void wb_gettoken_cache_flush(void);
 struct tevent_req *winbindd_getgroups_send(TALLOC_CTX *mem_ctx,
 					   struct tevent_context *ev,
 					   struct winbindd_cli_state *cli,
@@ -302,6 +302,13 @@ static NTSTATUS add_trusted_domain(const char *domain_name,
 		return NT_STATUS_NO_MEMORY;
 	}
 
+	domain->prio_queue = tevent_queue_create(domain,
+						 "winbind_domain_prio");
+	if (domain->prio_queue == NULL) {
+		TALLOC_FREE(domain);
+		return NT_STATUS_NO_MEMORY;
+	}
+
 	domain->binding_handle = wbint_binding_handle(domain, domain, NULL);
 	if (domain->binding_handle == NULL) {
 		TALLOC_FREE(domain);
@@ -1002,6 +1009,42 @@ static void terminate_child(struct tevent_req *subreq)
 	free_domain(d);
 }
 
+static void terminate_domain(struct tevent_req *subreq);
+
+static void terminate_domain_prio_done(struct tevent_req *subreq)
+{
+	struct winbindd_domain *d =
+		tevent_req_callback_data(subreq,
+		struct winbindd_domain);
+	bool ok;
+
+	ok = tevent_queue_wait_recv(subreq);
+	SMB_ASSERT(ok);
+	TALLOC_FREE(subreq);
+
+	/*
+	 * The interactive logons are gone,
+	 * now wait for the rest.
+	 *
+	 * Our own wait entry in the priority
+	 * queue counts as a waiting logon, so a
+	 * request at the head of the normal queue
+	 * may have yielded to it and stopped the
+	 * queue. Nothing else would restart it.
+	 */
+	tevent_queue_start(d->queue);
+
+	subreq = tevent_queue_wait_send(d,
+					global_event_context(),
+					d->queue);
+	if (subreq == NULL) {
+		return;
+	}
+	tevent_req_set_callback(subreq,
+				terminate_domain,
+				d);
+}
+
 static void terminate_domain(struct tevent_req *subreq)
 {
 	struct winbindd_domain *d =
@@ -1124,7 +1167,7 @@ static bool remove_trusted_domains_dc(void)
 	/*
 	 * For trusted domain
 	 * we need to wait in
-	 * the domain queue in order
+	 * the domain queues in order
 	 * to let pending requests
 	 * use the existing domain
 	 * children.
@@ -1138,12 +1181,12 @@ static bool remove_trusted_domains_dc(void)
 
 		subreq = tevent_queue_wait_send(d,
 						global_event_context(),
-						d->queue);
+						d->prio_queue);
 		if (subreq == NULL) {
 			return false;
 		}
 		tevent_req_set_callback(subreq,
-					terminate_domain,
+					terminate_domain_prio_done,
 					d);
 
 		DLIST_REMOVE(_domain_list, d);
@@ -848,6 +848,19 @@ init_sec_context_done:
 			case (OM_uint32)KRB5KRB_AP_ERR_MSG_TYPE:
 				/* garbage input, possibly from the auto-mech detection */
 				return NT_STATUS_INVALID_PARAMETER;
+			case (OM_uint32)KRB5KRB_AP_ERR_MODIFIED:
+			case (OM_uint32)KRB5KRB_AP_ERR_BADKEYVER:
+				if (gensec_security->gensec_role == GENSEC_CLIENT &&
+				    gensec_gssapi_state->target_principal != NULL) {
+					/*
+					 * The key of the target changed, don't
+					 * reuse the ticket on the next connect.
+					 */
+					cli_credentials_forget_service_ticket(
+						gensec_get_credentials(gensec_security),
+						gensec_gssapi_state->target_principal);
+				}
+				FALL_THROUGH;
 			default:
 				DEBUG(1, ("GSS %s Update(krb5)(%d) Update failed: %s\n",
 					  gensec_security->gensec_role == GENSEC_CLIENT ? "client" : "server",
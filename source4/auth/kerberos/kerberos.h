@@ -35,6 +35,8 @@ struct cli_credentials;
 struct ccache_container {
 	struct smb_krb5_context *smb_krb5_context;
 	krb5_ccache ccache;
+	/* hand the service tickets to the process-wide cache when freed */
+	bool share_service_tickets;
 };
 
 struct keytab_container {
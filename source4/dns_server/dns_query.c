@@ -32,6 +32,7 @@
 #include "dns_server/dns_server.h"
 #include "libcli/dns/libdns.h"
 #include "lib/util/dlinklist.h"
+#include "lib/util/memcache.h"
 #include "lib/util/util_net.h"
 #include "lib/util/tevent_werror.h"
 #include "auth/auth.h"
@@ -270,7 +271,229 @@ static WERROR add_dns_res_rec(struct dns_res_rec **pdst,
 	return WERR_OK;
 }
 
+/*
+ * Replies from the forwarders are cached in dns->forwarder_cache, keyed
+ * by the question, as the NDR encoded packet behind this header.
+ */
+struct dns_forwarder_cache_hdr {
+	time_t stored;
+	time_t expires;
+};
+
+static DATA_BLOB dns_forwarder_cache_key(TALLOC_CTX *mem_ctx,
+					 const struct dns_name_question *question)
+{
+	char *name = NULL;
+	char *key = NULL;
+
+	name = strlower_talloc(mem_ctx, question->name);
+	if (name == NULL) {
+		return data_blob_null;
+	}
+
+	key = talloc_asprintf(mem_ctx, "%u/%u/%s",
+			      (unsigned)question->question_class,
+			      (unsigned)question->question_type,
+			      name);
+	TALLOC_FREE(name);
+	if (key == NULL) {
+		return data_blob_null;
+	}
+
+	return data_blob_string_const(key);
+}
+
+static void dns_forwarder_cache_age(struct dns_res_rec *recs,
+				    uint16_t count,
+				    uint32_t age)
+{
+	uint16_t i;
+
+	for (i = 0; i < count; i++) {
+		if (recs[i].rr_type == DNS_QTYPE_OPT) {
+			continue;
+		}
+		recs[i].ttl = (recs[i].ttl > age) ? recs[i].ttl - age : 0;
+	}
+}
+
+static bool dns_forwarder_cache_fetch(struct dns_server *dns,
+				      TALLOC_CTX *mem_ctx,
+				      const struct dns_name_question *question,
+				      struct dns_name_packet **reply)
+{
+	struct dns_forwarder_cache_hdr hdr;
+	struct dns_name_packet *packet = NULL;
+	enum ndr_err_code ndr_err;
+	DATA_BLOB key;
+	DATA_BLOB value;
+	DATA_BLOB blob;
+	time_t now;
+	bool ok;
+
+	if (dns->forwarder_cache == NULL) {
+		return false;
+	}
+
+	key = dns_forwarder_cache_key(mem_ctx, question);
+	if (key.data == NULL) {
+		return false;
+	}
+
+	ok = memcache_lookup(dns->forwarder_cache, DNS_FORWARDER_CACHE,
+			     key, &value);
+	if (!ok || value.length < sizeof(hdr)) {
+		goto miss;
+	}
+
+	memcpy(&hdr, value.data, sizeof(hdr));
+
+	now = time(NULL);
+	if (now >= hdr.expires) {
+		memcache_delete(dns->forwarder_cache, DNS_FORWARDER_CACHE, key);
+		goto miss;
+	}
+
+	packet = talloc_zero(mem_ctx, struct dns_name_packet);
+	if (packet == NULL) {
+		goto miss;
+	}
+
+	blob = data_blob_const(value.data + sizeof(hdr),
+			       value.length - sizeof(hdr));
+	ndr_err = ndr_pull_struct_blob(
+		&blob, packet, packet,
+		(ndr_pull_flags_fn_t)ndr_pull_dns_name_packet);
+	if (!NDR_ERR_CODE_IS_SUCCESS(ndr_err)) {
+		TALLOC_FREE(packet);
+		memcache_delete(dns->forwarder_cache, DNS_FORWARDER_CACHE, key);
+		goto miss;
+	}
+
+	dns_forwarder_cache_age(packet->answers, packet->ancount,
+				now - hdr.stored);
+	dns_forwarder_cache_age(packet->nsrecs, packet->nscount,
+				now - hdr.stored);
+	dns_forwarder_cache_age(packet->additional, packet->arcount,
+				now - hdr.stored);
+
+	dns->forwarder_cache_hits++;
+	if (packet->ancount == 0) {
+		dns->forwarder_cache_negative_hits++;
+	}
+	if ((dns->forwarder_cache_hits % 1000) == 0) {
+		DBG_INFO("forwarder cache: %"PRIu64" hits "
+			 "(%"PRIu64" negative), %"PRIu64" misses\n",
+			 dns->forwarder_cache_hits,
+			 dns->forwarder_cache_negative_hits,
+			 dns->forwarder_cache_misses);
+	}
+
+	data_blob_free(&key);
+	*reply = packet;
+	return true;
+
+miss:
+	dns->forwarder_cache_misses++;
+	data_blob_free(&key);
+	return false;
+}
+
+/*
+ * A reply is kept for the smallest TTL of the records in its answer and
+ * authority sections. A reply without answers (NXDOMAIN or NODATA) is
+ * kept for the negative TTL given by the SOA in its authority section,
+ * as in RFC 2308, and is not cached at all without one. Both are capped
+ * at "dns:forwarder cache max ttl". Failures are never cached.
+ */
+static void dns_forwarder_cache_store(struct dns_server *dns,
+				      const struct dns_name_question *question,
+				      struct dns_name_packet *reply)
+{
+	TALLOC_CTX *frame = NULL;
+	struct dns_forwarder_cache_hdr hdr;
+	uint16_t rcode = reply->operation & DNS_RCODE;
+	uint32_t ttl = dns->forwarder_cache_max_ttl;
+	enum ndr_err_code ndr_err;
+	DATA_BLOB key;
+	DATA_BLOB packed;
+	DATA_BLOB value;
+	uint16_t i;
+
+	if (dns->forwarder_cache == NULL) {
+		return;
+	}
+
+	if (rcode != DNS_RCODE_OK && rcode != DNS_RCODE_NXDOMAIN) {
+		return;
+	}
+
+	if (reply->operation & DNS_FLAG_TRUNCATION) {
+		return;
+	}
+
+	if (reply->ancount > 0) {
+		for (i = 0; i < reply->ancount; i++) {
+			ttl = MIN(ttl, reply->answers[i].ttl);
+		}
+		for (i = 0; i < reply->nscount; i++) {
+			ttl = MIN(ttl, reply->nsrecs[i].ttl);
+		}
+	} else {
+		bool have_soa = false;
+
+		for (i = 0; i < reply->nscount; i++) {
+			const struct dns_res_rec *rr = &reply->nsrecs[i];
+
+			if (rr->rr_type != DNS_QTYPE_SOA) {
+				continue;
+			}
+			ttl = MIN(ttl, rr->ttl);
+			ttl = MIN(ttl, rr->rdata.soa_record.minimum);
+			have_soa = true;
+		}
+		if (!have_soa) {
+			return;
+		}
+	}
+
+	if (ttl == 0) {
+		return;
+	}
+
+	frame = talloc_stackframe();
+
+	key = dns_forwarder_cache_key(frame, question);
+	if (key.data == NULL) {
+		goto done;
+	}
+
+	ndr_err = ndr_push_struct_blob(
+		&packed, frame, reply,
+		(ndr_push_flags_fn_t)ndr_push_dns_name_packet);
+	if (!NDR_ERR_CODE_IS_SUCCESS(ndr_err)) {
+		goto done;
+	}
+
+	hdr.stored = time(NULL);
+	hdr.expires = hdr.stored + ttl;
+
+	value = data_blob_talloc(frame, NULL, sizeof(hdr) + packed.length);
+	if (value.data == NULL) {
+		goto done;
+	}
+	memcpy(value.data, &hdr, sizeof(hdr));
+	memcpy(value.data + sizeof(hdr), packed.data, packed.length);
+
+	memcache_add(dns->forwarder_cache, DNS_FORWARDER_CACHE, key, value);
+
+done:
+	TALLOC_FREE(frame);
+}
+
 struct ask_forwarder_state {
+	struct dns_server *dns;
+	const struct dns_name_question *question;
 	struct dns_name_packet *reply;
 };
 
@@ -278,6 +501,7 @@ static void ask_forwarder_done(struct tevent_req *subreq);
 
 static struct tevent_req *ask_forwarder_send(
 	TALLOC_CTX *mem_ctx, struct tevent_context *ev,
+	struct dns_server *dns,
 	const char *forwarder, struct dns_name_question *question)
 {
 	struct tevent_req *req, *subreq;
@@ -287,6 +511,13 @@ static struct tevent_req *ask_forwarder_send(
 	if (req == NULL) {
 		return NULL;
 	}
+	state->dns = dns;
+	state->question = question;
+
+	if (dns_forwarder_cache_fetch(dns, state, question, &state->reply)) {
+		tevent_req_done(req);
+		return tevent_req_post(req, ev);
+	}
 
 	subreq = dns_cli_request_send(state, ev, forwarder,
 				      question->name, question->question_class,
@@ -314,6 +545,8 @@ static void ask_forwarder_done(struct tevent_req *subreq)
 		return;
 	}
 
+	dns_forwarder_cache_store(state->dns, state->question, state->reply);
+
 	tevent_req_done(req);
 }
 
@@ -476,7 +709,7 @@ static struct tevent_req *handle_dnsrpcrec_send(
 		return req;
 	}
 
-	subreq = ask_forwarder_send(state, ev, forwarder, new_q);
+	subreq = ask_forwarder_send(state, ev, dns, forwarder, new_q);
 	if (tevent_req_nomem(subreq, req)) {
 		return tevent_req_post(req, ev);
 	}
@@ -1035,7 +1268,7 @@ struct tevent_req *dns_server_process_query_send(
 		DEBUG(5, ("Not authoritative for '%s', forwarding\n",
 			  in->questions[0].name));
 
-		subreq = ask_forwarder_send(state, ev,
+		subreq = ask_forwarder_send(state, ev, dns,
 					    (forwarders == NULL ? NULL : forwarders[0]),
 					    &in->questions[0]);
 		if (tevent_req_nomem(subreq, req)) {
@@ -1078,7 +1311,7 @@ static void dns_server_process_query_got_response(struct tevent_req *subreq)
 
 		DEBUG(5, ("DNS query returned %s, trying another forwarder.\n",
 			  win_errstr(werr)));
-		subreq = ask_forwarder_send(state, state->ev,
+		subreq = ask_forwarder_send(state, state->ev, state->dns,
 					    state->forwarders->forwarder,
 					    state->question);
 
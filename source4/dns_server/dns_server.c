@@ -42,6 +42,7 @@
 #include "dsdb/common/util.h"
 #include "auth/session.h"
 #include "lib/util/dlinklist.h"
+#include "lib/util/memcache.h"
 #include "lib/util/tevent_werror.h"
 #include "auth/auth.h"
 #include "auth/credentials/credentials.h"
@@ -643,6 +644,8 @@ static NTSTATUS dns_add_socket(struct dns_server *dns,
 	struct dns_socket *dns_socket;
 	struct dns_udp_socket *dns_udp_socket;
 	struct tevent_req *udpsubreq;
+	const char *udp_options = NULL;
+	int rcvbuf;
 	NTSTATUS status;
 	int ret;
 
@@ -680,10 +683,23 @@ static NTSTATUS dns_add_socket(struct dns_server *dns,
 
 	dns_udp_socket->dns_socket = dns_socket;
 
-	ret = tdgram_inet_udp_socket(dns_socket->local_address,
-				     NULL,
-				     dns_udp_socket,
-				     &dns_udp_socket->dgram);
+	/*
+	 * A larger receive buffer lets the kernel queue bursts of
+	 * queries or updates arriving while a request is processed,
+	 * instead of dropping them. It is capped at net.core.rmem_max.
+	 */
+	rcvbuf = lpcfg_parm_int(dns->task->lp_ctx, NULL, "dns",
+				"udp receive buffer", 1024 * 1024);
+	if (rcvbuf > 0) {
+		udp_options = talloc_asprintf(dns_udp_socket,
+					      "SO_RCVBUF=%d", rcvbuf);
+		NT_STATUS_HAVE_NO_MEMORY(udp_options);
+	}
+
+	ret = dgram_setup_socket(dns_udp_socket,
+				 dns_socket->local_address,
+				 udp_options,
+				 &dns_udp_socket->dgram);
 	if (ret != 0) {
 		status = map_nt_error_from_unix_common(errno);
 		DEBUG(0,("Failed to bind to %s:%u UDP - %s\n",
@@ -790,6 +806,10 @@ static NTSTATUS dns_server_reload_zones(struct dns_server *dns)
 		talloc_free(old_zone);
 	}
 
+	if (dns->record_cache != NULL) {
+		memcache_flush(dns->record_cache, DNS_RECORD_CACHE_TALLOC);
+	}
+
 	return NT_STATUS_OK;
 }
 
@@ -824,6 +844,7 @@ static NTSTATUS dns_task_init(struct task_server *task)
 	struct ldb_message *dns_acc;
 	const char *dns_hostname = NULL;
 	char *dns_spn;
+	int cache_size;
 	bool ok;
 
 	switch (lpcfg_server_role(task->lp_ctx)) {
@@ -922,6 +943,41 @@ static NTSTATUS dns_task_init(struct task_server *task)
 		}
 	}
 
+	/*
+	 * Cache of the records found for recently queried names, so that
+	 * repeated queries do not need an LDB search and NDR unpacking.
+	 * "dns:record cache size" is in bytes, 0 disables the cache.
+	 */
+	cache_size = lpcfg_parm_int(task->lp_ctx, NULL, "dns",
+				    "record cache size", 4 * 1024 * 1024);
+	dns->record_cache_ttl = lpcfg_parm_int(task->lp_ctx, NULL, "dns",
+					       "record cache ttl", 60);
+	if (cache_size > 0 && dns->record_cache_ttl > 0) {
+		dns->record_cache = memcache_init(dns, cache_size);
+		if (dns->record_cache == NULL) {
+			task_server_terminate(task, "dns: out of memory", true);
+			return NT_STATUS_NO_MEMORY;
+		}
+	}
+
+	/*
+	 * Cache of the replies received from the forwarders, see
+	 * dns_forwarder_cache_store().
+	 */
+	cache_size = lpcfg_parm_int(task->lp_ctx, NULL, "dns",
+				    "forwarder cache size", 4 * 1024 * 1024);
+	dns->forwarder_cache_max_ttl = lpcfg_parm_ulong(task->lp_ctx, NULL,
+							"dns",
+							"forwarder cache max ttl",
+							3600);
+	if (cache_size > 0 && dns->forwarder_cache_max_ttl > 0) {
+		dns->forwarder_cache = memcache_init(dns, cache_size);
+		if (dns->forwarder_cache == NULL) {
+			task_server_terminate(task, "dns: out of memory", true);
+			return NT_STATUS_NO_MEMORY;
+		}
+	}
+
 	dns->tkeys = tkey_store_init(dns, TKEY_BUFFER_SIZE);
 	if (!dns->tkeys) {
 		task_server_terminate(task, "Failed to allocate tkey storage\n", true);
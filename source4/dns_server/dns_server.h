@@ -27,6 +27,7 @@
 #include "dnsserver_common.h"
 
 struct tsocket_address;
+struct memcache;
 struct dns_server_tkey {
 	const char *name;
 	enum dns_tkey_mode mode;
@@ -50,6 +51,13 @@ struct dns_server {
 	struct dns_server_zone *zones;
 	struct dns_server_tkey_store *tkeys;
 	struct cli_credentials *server_credentials;
+	struct memcache *record_cache;
+	int record_cache_ttl;
+	struct memcache *forwarder_cache;
+	uint32_t forwarder_cache_max_ttl;
+	uint64_t forwarder_cache_hits;
+	uint64_t forwarder_cache_negative_hits;
+	uint64_t forwarder_cache_misses;
 };
 
 struct dns_request_state {
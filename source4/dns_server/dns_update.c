@@ -32,6 +32,7 @@
 #include "samba/service_task.h"
 #include "dns_server/dns_server.h"
 #include "auth/auth.h"
+#include "lib/util/dlinklist.h"
 
 #undef DBGC_CLASS
 #define DBGC_CLASS DBGC_DNS
@@ -378,8 +379,149 @@ done:
 }
 
 
+/*
+ * The records of the dnsNodes written so far while processing one update
+ * message. Windows clients typically send several updates for the same
+ * name in one message (e.g. delete all A records, then add one), and
+ * this lets each update after the first start from the records we just
+ * wrote, rather than searching for and unpacking the node again.
+ */
+struct dns_update_node {
+	struct dns_update_node *prev, *next;
+	struct ldb_dn *dn;
+	struct dnsp_DnssrvRpcRecord *recs;
+	uint16_t rcount;
+};
+
+struct dns_update_nodes {
+	struct dns_update_node *nodes;
+};
+
+static struct dns_update_node *dns_update_node_find(
+	struct dns_update_nodes *nodes,
+	struct ldb_dn *dn)
+{
+	struct dns_update_node *node = NULL;
+
+	for (node = nodes->nodes; node != NULL; node = node->next) {
+		if (ldb_dn_compare(node->dn, dn) == 0) {
+			return node;
+		}
+	}
+
+	return NULL;
+}
+
+/*
+ * Like dns_common_lookup(), but answered from the nodes already
+ * written by this message where possible.
+ */
+static WERROR dns_update_node_lookup(struct dns_update_nodes *nodes,
+				     struct dns_server *dns,
+				     TALLOC_CTX *mem_ctx,
+				     struct ldb_dn *dn,
+				     struct dnsp_DnssrvRpcRecord **recs,
+				     uint16_t *rcount,
+				     bool *tombstoned)
+{
+	struct dns_update_node *node = NULL;
+	struct dnsp_DnssrvRpcRecord *copy = NULL;
+
+	node = dns_update_node_find(nodes, dn);
+	if (node == NULL) {
+		return dns_common_lookup(dns->samdb, mem_ctx, dn,
+					 recs, rcount, tombstoned);
+	}
+
+	/*
+	 * The caller modifies the array, but only replaces whole
+	 * records, so a shallow copy is enough. The record data lives
+	 * as long as the nodes, until the whole message is done.
+	 */
+	copy = talloc_array(mem_ctx, struct dnsp_DnssrvRpcRecord,
+			    node->rcount);
+	W_ERROR_HAVE_NO_MEMORY(copy);
+	memcpy(copy, node->recs, sizeof(*copy) * node->rcount);
+
+	*recs = copy;
+	*rcount = node->rcount;
+	*tombstoned = false;
+
+	return WERR_OK;
+}
+
+/*
+ * dns_replace_records(), remembering what was written for
+ * dns_update_node_lookup().
+ */
+static WERROR dns_update_node_replace(struct dns_update_nodes *nodes,
+				      struct dns_server *dns,
+				      TALLOC_CTX *mem_ctx,
+				      struct ldb_dn *dn,
+				      bool needs_add,
+				      struct dnsp_DnssrvRpcRecord *recs,
+				      uint16_t rcount)
+{
+	struct dns_update_node *node = NULL;
+	uint16_t live = 0;
+	uint16_t i;
+	WERROR werror;
+
+	node = dns_update_node_find(nodes, dn);
+	if (node != NULL) {
+		/*
+		 * The caller's records may still point into the data of
+		 * the old node, so it is only unlinked, not freed.
+		 */
+		DLIST_REMOVE(nodes->nodes, node);
+		node = NULL;
+	}
+
+	werror = dns_replace_records(dns, mem_ctx, dn, needs_add,
+				     recs, rcount);
+	if (!W_ERROR_IS_OK(werror)) {
+		return werror;
+	}
+
+	/*
+	 * dns_common_replace() has sorted the records into the order
+	 * they are stored in and updated their serial and timestamps.
+	 * What was written is all but the tombstones. If nothing was
+	 * left, the node is now a tombstone and we leave it to
+	 * dns_common_lookup() to describe it.
+	 */
+	for (i = 0; i < rcount; i++) {
+		if (recs[i].wType != DNS_TYPE_TOMBSTONE) {
+			live++;
+		}
+	}
+	if (live == 0) {
+		return WERR_OK;
+	}
+
+	node = talloc_zero(nodes, struct dns_update_node);
+	if (node == NULL) {
+		return WERR_OK;
+	}
+	node->dn = ldb_dn_copy(node, dn);
+	node->recs = talloc_array(node, struct dnsp_DnssrvRpcRecord, live);
+	if (node->dn == NULL || node->recs == NULL) {
+		TALLOC_FREE(node);
+		return WERR_OK;
+	}
+	for (i = 0; i < rcount; i++) {
+		if (recs[i].wType != DNS_TYPE_TOMBSTONE) {
+			node->recs[node->rcount++] = recs[i];
+		}
+	}
+	DLIST_ADD(nodes->nodes, node);
+
+	return WERR_OK;
+}
+
 static WERROR handle_one_update(struct dns_server *dns,
 				TALLOC_CTX *mem_ctx,
+				struct dns_update_nodes *nodes,
 				const struct dns_name_question *zone,
 				const struct dns_res_rec *update,
 				const struct dns_server_tkey *tkey)
@@ -421,9 +563,9 @@ static WERROR handle_one_update(struct dns_server *dns,
 	DBG_DEBUG("dns_name2dn(): %s\n", win_errstr(werror));
 	W_ERROR_NOT_OK_RETURN(werror);
 
-	werror = dns_common_lookup(dns->samdb, mem_ctx, dn,
-				   &recs, &rcount, &tombstoned);
-	DBG_DEBUG("dns_common_lookup(): %s\n", win_errstr(werror));
+	werror = dns_update_node_lookup(nodes, dns, mem_ctx, dn,
+					&recs, &rcount, &tombstoned);
+	DBG_DEBUG("dns_update_node_lookup(): %s\n", win_errstr(werror));
 	if (W_ERROR_EQUAL(werror, WERR_DNS_ERROR_NAME_DOES_NOT_EXIST)) {
 		needs_add = true;
 		werror = WERR_OK;
@@ -479,8 +621,8 @@ static WERROR handle_one_update(struct dns_server *dns,
 			W_ERROR_NOT_OK_RETURN(werror);
 			rcount += 1;
 
-			werror = dns_replace_records(dns, mem_ctx, dn,
-						     needs_add, recs, rcount);
+			werror = dns_update_node_replace(nodes, dns, mem_ctx, dn,
+							 needs_add, recs, rcount);
 			DBG_DEBUG("dns_replace_records(CNAME): %s\n", win_errstr(werror));
 			W_ERROR_NOT_OK_RETURN(werror);
 
@@ -552,8 +694,8 @@ static WERROR handle_one_update(struct dns_server *dns,
 				};
 			}
 
-			werror = dns_replace_records(dns, mem_ctx, dn,
-						     needs_add, recs, rcount);
+			werror = dns_update_node_replace(nodes, dns, mem_ctx, dn,
+							 needs_add, recs, rcount);
 			DBG_DEBUG("dns_replace_records(SOA): %s\n", win_errstr(werror));
 			W_ERROR_NOT_OK_RETURN(werror);
 
@@ -582,8 +724,8 @@ static WERROR handle_one_update(struct dns_server *dns,
 			recs[i].rank = recs[rcount].rank;
 			recs[i].dwReserved = 0;
 			recs[i].flags = 0;
-			werror = dns_replace_records(dns, mem_ctx, dn,
-						     needs_add, recs, rcount);
+			werror = dns_update_node_replace(nodes, dns, mem_ctx, dn,
+							 needs_add, recs, rcount);
 			DBG_DEBUG("dns_replace_records(REPLACE): %s\n", win_errstr(werror));
 			if (W_ERROR_EQUAL(werror, WERR_ACCESS_DENIED) &&
 			    !needs_add &&
@@ -599,8 +741,8 @@ static WERROR handle_one_update(struct dns_server *dns,
 			return WERR_OK;
 		}
 		/* we did not find a matching record. This is new. */
-		werror = dns_replace_records(dns, mem_ctx, dn,
-					     needs_add, recs, rcount+1);
+		werror = dns_update_node_replace(nodes, dns, mem_ctx, dn,
+						 needs_add, recs, rcount+1);
 		DBG_DEBUG("dns_replace_records(ADD): %s\n", win_errstr(werror));
 		W_ERROR_NOT_OK_RETURN(werror);
 
@@ -654,8 +796,8 @@ static WERROR handle_one_update(struct dns_server *dns,
 			}
 		}
 
-		werror = dns_replace_records(dns, mem_ctx, dn,
-					     needs_add, recs, rcount);
+		werror = dns_update_node_replace(nodes, dns, mem_ctx, dn,
+						 needs_add, recs, rcount);
 		DBG_DEBUG("dns_replace_records(DELETE-ANY): %s\n", win_errstr(werror));
 		W_ERROR_NOT_OK_RETURN(werror);
 
@@ -705,8 +847,8 @@ static WERROR handle_one_update(struct dns_server *dns,
 			}
 		}
 
-		werror = dns_replace_records(dns, mem_ctx, dn,
-					     needs_add, recs, rcount);
+		werror = dns_update_node_replace(nodes, dns, mem_ctx, dn,
+						 needs_add, recs, rcount);
 		DBG_DEBUG("dns_replace_records(DELETE-NONE): %s\n", win_errstr(werror));
 		W_ERROR_NOT_OK_RETURN(werror);
 	}
@@ -722,6 +864,7 @@ static WERROR handle_updates(struct dns_server *dns,
 			     struct dns_server_tkey *tkey)
 {
 	struct ldb_dn *zone_dn = NULL;
+	struct dns_update_nodes *nodes = NULL;
 	WERROR werror = WERR_OK;
 	int ret;
 	uint16_t ri;
@@ -754,8 +897,14 @@ static WERROR handle_updates(struct dns_server *dns,
 
 	DBG_DEBUG("dns update count is %u\n", upd_count);
 
+	nodes = talloc_zero(tmp_ctx, struct dns_update_nodes);
+	if (nodes == NULL) {
+		werror = WERR_NOT_ENOUGH_MEMORY;
+		goto failed;
+	}
+
 	for (ri = 0; ri < upd_count; ri++) {
-		werror = handle_one_update(dns, tmp_ctx, zone,
+		werror = handle_one_update(dns, tmp_ctx, nodes, zone,
 					   &updates[ri], tkey);
 		DBG_DEBUG("handle_one_update(%u): %s\n",
 			  ri, win_errstr(werror));
@@ -28,6 +28,7 @@
 #include <ldb.h>
 #include "dsdb/samdb/samdb.h"
 #include "dsdb/common/util.h"
+#include "lib/util/memcache.h"
 #include "dns_server/dns_server.h"
 
 #undef DBGC_CLASS
@@ -48,9 +49,28 @@ WERROR dns_lookup_records(struct dns_server *dns,
 				 records, rec_count, NULL);
 }
 
+/*
+ * Records answered for a query DN, as cached in dns->record_cache.
+ *
+ * An entry is only valid while the sam.ldb sequence number is
+ * unchanged, so any update (local or replicated) to any zone
+ * invalidates it, and for at most dns->record_cache_ttl seconds.
+ * Non-existent names are cached as well, with werr set.
+ */
+struct dns_record_cache_entry {
+	uint64_t seq_num;
+	time_t expires;
+	WERROR werr;
+	struct dnsp_DnssrvRpcRecord *records;
+	uint16_t rec_count;
+};
+
 /*
  * Lookup a DNS record, will match DNS wild card records if an exact match
- * is not found.
+ * is not found. Answers from the record cache when possible.
+ *
+ * The returned records may be shared with the cache and must not be
+ * modified.
  */
 WERROR dns_lookup_records_wildcard(struct dns_server *dns,
 			  TALLOC_CTX *mem_ctx,
@@ -58,8 +78,83 @@ WERROR dns_lookup_records_wildcard(struct dns_server *dns,
 			  struct dnsp_DnssrvRpcRecord **records,
 			  uint16_t *rec_count)
 {
-	return dns_common_wildcard_lookup(dns->samdb, mem_ctx, dn,
-				 records, rec_count);
+	struct dns_record_cache_entry *e = NULL;
+	const char *key = NULL;
+	uint64_t seq_num = 0;
+	time_t now;
+	WERROR werr;
+	int ret;
+
+	if (dns->record_cache == NULL) {
+		return dns_common_wildcard_lookup(dns->samdb, mem_ctx, dn,
+						  records, rec_count);
+	}
+
+	ret = ldb_sequence_number(dns->samdb, LDB_SEQ_HIGHEST_SEQ, &seq_num);
+	key = ldb_dn_get_casefold(dn);
+	if (ret != LDB_SUCCESS || key == NULL) {
+		return dns_common_wildcard_lookup(dns->samdb, mem_ctx, dn,
+						  records, rec_count);
+	}
+
+	now = time(NULL);
+
+	e = memcache_lookup_talloc(dns->record_cache,
+				   DNS_RECORD_CACHE_TALLOC,
+				   data_blob_string_const(key));
+	if (e != NULL) {
+		if (e->seq_num == seq_num && e->expires >= now) {
+			if (!W_ERROR_IS_OK(e->werr)) {
+				return e->werr;
+			}
+			if (e->records != NULL &&
+			    talloc_reference(mem_ctx, e->records) == NULL) {
+				return WERR_NOT_ENOUGH_MEMORY;
+			}
+			*records = e->records;
+			*rec_count = e->rec_count;
+			return WERR_OK;
+		}
+		memcache_delete(dns->record_cache,
+				DNS_RECORD_CACHE_TALLOC,
+				data_blob_string_const(key));
+		e = NULL;
+	}
+
+	werr = dns_common_wildcard_lookup(dns->samdb, mem_ctx, dn,
+					  records, rec_count);
+	if (!W_ERROR_IS_OK(werr) &&
+	    !W_ERROR_EQUAL(werr, WERR_DNS_ERROR_NAME_DOES_NOT_EXIST) &&
+	    !W_ERROR_EQUAL(werr, DNS_ERR(NAME_ERROR))) {
+		return werr;
+	}
+
+	e = talloc_zero(NULL, struct dns_record_cache_entry);
+	if (e == NULL) {
+		return werr;
+	}
+	e->seq_num = seq_num;
+	e->expires = now + dns->record_cache_ttl;
+	e->werr = werr;
+
+	if (W_ERROR_IS_OK(werr) && *records != NULL) {
+		/*
+		 * The cache owns the records, so that they are accounted
+		 * for in its size, and the caller holds a reference.
+		 */
+		e->records = talloc_steal(e, *records);
+		if (talloc_reference(mem_ctx, e->records) == NULL) {
+			talloc_steal(mem_ctx, *records);
+			TALLOC_FREE(e);
+			return werr;
+		}
+		e->rec_count = *rec_count;
+	}
+
+	memcache_add_talloc(dns->record_cache, DNS_RECORD_CACHE_TALLOC,
+			    data_blob_string_const(key), &e);
+
+	return werr;
 }
 
 WERROR dns_replace_records(struct dns_server *dns,
@@ -731,6 +731,119 @@ static NTSTATUS kccsrv_check_deleted(struct kccsrv_service *s, TALLOC_CTX *mem_c
 	return status;
 }
 
+/*
+ * Run one DSDB_EXTENDED_SEC_DESC_PROPAGATION_BATCH_OID operation
+ * in its own transaction.
+ */
+static int kccsrv_sd_propagation_batch(struct kccsrv_service *s,
+				       struct dsdb_extended_sec_desc_propagation_batch *op)
+{
+	struct ldb_result *res = NULL;
+	int ret;
+
+	ret = ldb_transaction_start(s->samdb);
+	if (ret != LDB_SUCCESS) {
+		DBG_ERR("Failed to start transaction - %s\n",
+			ldb_errstring(s->samdb));
+		return ret;
+	}
+
+	ret = ldb_extended(s->samdb,
+			   DSDB_EXTENDED_SEC_DESC_PROPAGATION_BATCH_OID,
+			   op, &res);
+	if (ret != LDB_SUCCESS) {
+		DBG_ERR("SD propagation batch failed - %s\n",
+			ldb_errstring(s->samdb));
+		ldb_transaction_cancel(s->samdb);
+		return ret;
+	}
+	TALLOC_FREE(res);
+
+	ret = ldb_transaction_commit(s->samdb);
+	if (ret != LDB_SUCCESS) {
+		DBG_ERR("Failed to commit SD propagation batch - %s\n",
+			ldb_errstring(s->samdb));
+		return ret;
+	}
+
+	return LDB_SUCCESS;
+}
+
+/*
+ * Process the queued security descriptor propagation of large
+ * subtrees, see "dsdb:sd propagation batch size". Each batch runs
+ * in its own short transaction, so other writers are only blocked
+ * for the duration of a single batch.
+ *
+ * A subtree that fails is moved to the end of the queue and
+ * retried once the others had their turn.
+ */
+static NTSTATUS kccsrv_sd_propagation(struct kccsrv_service *s,
+				      TALLOC_CTX *mem_ctx)
+{
+	int max_batches = lpcfg_parm_int(s->task->lp_ctx, NULL, "kccsrv",
+					 "sd_propagation_max_batches", 100);
+	int batch_size = lpcfg_parm_int(s->task->lp_ctx, NULL, "kccsrv",
+					"sd_propagation_batch_size", 0);
+	struct dsdb_extended_sec_desc_propagation_batch *op = NULL;
+	NTSTATUS status = NT_STATUS_OK;
+	uint32_t num_processed = 0;
+	uint32_t num_failed = 0;
+	int i;
+	int ret;
+
+	op = talloc_zero(mem_ctx, struct dsdb_extended_sec_desc_propagation_batch);
+	if (op == NULL) {
+		return NT_STATUS_NO_MEMORY;
+	}
+
+	for (i = 0; i < max_batches; i++) {
+		*op = (struct dsdb_extended_sec_desc_propagation_batch) {
+			.max_objects = MAX(batch_size, 0),
+		};
+
+		ret = kccsrv_sd_propagation_batch(s, op);
+		if (ret != LDB_SUCCESS) {
+			status = dsdb_ldb_err_to_ntstatus(ret);
+			num_failed += 1;
+
+			*op = (struct dsdb_extended_sec_desc_propagation_batch) {
+				.requeue_head = true,
+			};
+
+			ret = kccsrv_sd_propagation_batch(s, op);
+			if (ret != LDB_SUCCESS) {
+				TALLOC_FREE(op);
+				return dsdb_ldb_err_to_ntstatus(ret);
+			}
+
+			if (num_failed >= op->num_pending) {
+				/*
+				 * Everything left failed during
+				 * this run, try again next time.
+				 */
+				break;
+			}
+			continue;
+		}
+
+		num_processed += op->num_processed;
+
+		if (op->num_pending == 0) {
+			break;
+		}
+	}
+
+	if (num_processed != 0 || op->num_pending != 0) {
+		DBG_NOTICE("SD propagation: %"PRIu32" objects processed, "
+			   "%"PRIu32" subtrees pending, %"PRIu32" failed\n",
+			   num_processed, op->num_pending, num_failed);
+	}
+
+	TALLOC_FREE(op);
+	return status;
+}
+
 static void kccsrv_periodic_run(struct kccsrv_service *service)
 {
 	TALLOC_CTX *mem_ctx;
@@ -757,6 +870,11 @@ static void kccsrv_periodic_run(struct kccsrv_service *service)
 	if (!NT_STATUS_IS_OK(status)) {
 		DEBUG(0,("kccsrv_check_deleted failed - %s\n", nt_errstr(status)));
 	}
+	status = kccsrv_sd_propagation(service, mem_ctx);
+	if (!NT_STATUS_IS_OK(status)) {
+		DBG_ERR("kccsrv_sd_propagation failed - %s\n",
+			nt_errstr(status));
+	}
 	status = kccsrv_dns_zone_scavenging(service, mem_ctx);
 	if (!NT_STATUS_IS_OK(status)) {
 		DBG_ERR("kccsrv_dns_zone_aging failed - %s\n",
@@ -1142,6 +1142,49 @@ static PyObject *py_dsdb_allocate_rid(PyObject *self, PyObject *args)
 	return PyLong_FromLong(rid);
 }
 
+/*
+  call DSDB_EXTENDED_SEC_DESC_PROPAGATION_BATCH to process the next batch
+  of the queued security descriptor propagation
+ */
+static PyObject *py_dsdb_sd_propagation_batch(PyObject *self, PyObject *args)
+{
+	PyObject *py_ldb;
+	struct ldb_context *ldb;
+	int ret;
+	unsigned int max_objects = 0;
+	struct ldb_result *ext_res = NULL;
+	struct dsdb_extended_sec_desc_propagation_batch *op = NULL;
+	PyObject *result = NULL;
+
+	if (!PyArg_ParseTuple(args, "O|I", &py_ldb, &max_objects)) {
+		return NULL;
+	}
+
+	PyErr_LDB_OR_RAISE(py_ldb, ldb);
+
+	op = talloc_zero(ldb, struct dsdb_extended_sec_desc_propagation_batch);
+	if (op == NULL) {
+		return PyErr_NoMemory();
+	}
+	op->max_objects = max_objects;
+
+	ret = ldb_extended(ldb,
+			   DSDB_EXTENDED_SEC_DESC_PROPAGATION_BATCH_OID,
+			   op,
+			   &ext_res);
+	if (ret != LDB_SUCCESS) {
+		TALLOC_FREE(op);
+		TALLOC_FREE(ext_res);
+		PyErr_LDB_ERROR_IS_ERR_RAISE(py_ldb_get_exception(), ret, ldb);
+	}
+
+	result = Py_BuildValue("(II)", op->num_processed, op->num_pending);
+	TALLOC_FREE(op);
+	TALLOC_FREE(ext_res);
+
+	return result;
+}
+
 #ifdef AD_DC_BUILD_IS_ENABLED
 /*
  * These functions will not work correctly on non-AD_DC builds.
@@ -1647,6 +1690,9 @@ static PyMethodDef py_dsdb_methods[] = {
 	{ "_dsdb_allocate_rid", (PyCFunction)py_dsdb_allocate_rid, METH_VARARGS,
 		"_dsdb_allocate_rid(samdb)"
 		" -> RID" },
+	{ "_dsdb_sd_propagation_batch", (PyCFunction)py_dsdb_sd_propagation_batch, METH_VARARGS,
+		"_dsdb_sd_propagation_batch(samdb, [max_objects])"
+		" -> (num_processed, num_pending)" },
 	{ "_dsdb_load_udv_v2", (PyCFunction)py_dsdb_load_udv_v2, METH_VARARGS, NULL },
 	{ "user_account_control_flag_bit_to_string",
 	        (PyCFunction)py_dsdb_user_account_control_flag_bit_to_string,
@@ -88,16 +88,49 @@ struct descriptor_transaction {
 		size_t num_registered;
 		size_t num_toplevel;
 		size_t num_processed;
+		size_t num_queued;
 	} changes;
 	struct {
 		struct db_context *map;
 		size_t num_processed;
 		size_t num_skipped;
 	} objects;
+	struct {
+		/*
+		 * Most objects below a container carry identical
+		 * inherited security descriptors, so the
+		 * propagation ends up computing the same result
+		 * over and over again.
+		 *
+		 * We keep a single instance of every distinct
+		 * descriptor blob we see during the transaction
+		 * (blob => instance id) and remember the
+		 * propagation result for each
+		 * (objectClass, parent instance, old instance)
+		 * tuple, so each distinct combination is only
+		 * unmarshalled and recalculated once.
+		 */
+		struct db_context *instances;
+		struct db_context *results;
+		uint32_t num_instances;
+		size_t num_hits;
+		size_t num_misses;
+	} sds;
 };
 
 struct descriptor_data {
 	struct descriptor_transaction transaction;
+	/*
+	 * Subtrees with more than this number of objects
+	 * are not propagated within the transaction that
+	 * changed the descriptor, but queued in the
+	 * @SD_PROPAGATION record and processed in batches
+	 * of separate transactions, see
+	 * DSDB_EXTENDED_SEC_DESC_PROPAGATION_BATCH_OID.
+	 *
+	 * 0 means all propagation happens synchronously.
+	 */
+	unsigned int batch_size;
 };
 
 struct descriptor_context {
@@ -504,6 +537,167 @@ static DATA_BLOB *get_new_descriptor(struct ldb_module *module,
 	return linear_sd;
 }
 
+struct descriptor_sd_result_key {
+	struct GUID schemaIDGUID;
+	uint32_t parent_id;
+	uint32_t old_id;
+};
+
+static void descriptor_sd_instance_parser(TDB_DATA key, TDB_DATA data, void *private_data)
+{
+	uint32_t *id = (uint32_t *)private_data;
+
+	SMB_ASSERT(data.dsize == sizeof(*id));
+
+	memcpy(id, data.dptr, data.dsize);
+}
+
+static void descriptor_sd_result_parser(TDB_DATA key, TDB_DATA data, void *private_data)
+{
+	DATA_BLOB **sd_ptr = (DATA_BLOB **)private_data;
+	uintptr_t ptr = 0;
+
+	SMB_ASSERT(data.dsize == sizeof(ptr));
+
+	memcpy(&ptr, data.dptr, data.dsize);
+
+	*sd_ptr = talloc_get_type_abort((void *)ptr, DATA_BLOB);
+}
+
+/*
+ * Return the transaction wide instance id of a
+ * security descriptor blob, 0 is reserved for
+ * "no descriptor".
+ */
+static NTSTATUS descriptor_sd_instance_id(struct descriptor_transaction *t,
+					  const struct ldb_val *sd,
+					  uint32_t *id)
+{
+	TDB_DATA key;
+	TDB_DATA val;
+	NTSTATUS status;
+
+	*id = 0;
+
+	if (sd == NULL) {
+		return NT_STATUS_OK;
+	}
+
+	key = make_tdb_data(sd->data, sd->length);
+	status = dbwrap_parse_record(t->sds.instances, key,
+				     descriptor_sd_instance_parser, id);
+	if (!NT_STATUS_EQUAL(status, NT_STATUS_NOT_FOUND)) {
+		return status;
+	}
+
+	if (t->sds.num_instances == UINT32_MAX) {
+		return NT_STATUS_INTEGER_OVERFLOW;
+	}
+	t->sds.num_instances += 1;
+	*id = t->sds.num_instances;
+
+	val = make_tdb_data((const void *)id, sizeof(*id));
+	return dbwrap_store(t->sds.instances, key, val, TDB_INSERT);
+}
+
+/*
+ * Recalculate the inherited parts of old_sd during
+ * SD propagation, reusing the result of an earlier
+ * calculation with the same input within the
+ * current transaction.
+ */
+static DATA_BLOB *descriptor_get_propagated_sd(struct ldb_module *module,
+					       struct ldb_dn *dn,
+					       TALLOC_CTX *mem_ctx,
+					       const struct dsdb_class *objectclass,
+					       const struct ldb_val *parent_sd,
+					       const struct ldb_val *old_sd)
+{
+	struct descriptor_data *descriptor_private =
+		talloc_get_type_abort(ldb_module_get_private(module),
+		struct descriptor_data);
+	struct descriptor_transaction *t = &descriptor_private->transaction;
+	struct descriptor_sd_result_key rkey = {
+		.schemaIDGUID = objectclass->schemaIDGUID,
+	};
+	DATA_BLOB *sd = NULL;
+	DATA_BLOB *cached = NULL;
+	TDB_DATA key;
+	TDB_DATA val;
+	NTSTATUS status;
+
+	if (t->mem == NULL || t->sds.results == NULL) {
+		return get_new_descriptor(module, dn, mem_ctx,
+					  objectclass, parent_sd,
+					  old_sd, old_sd, SECINFO_OWNER |
+					  SECINFO_GROUP | SECINFO_DACL |
+					  SECINFO_SACL);
+	}
+
+	status = descriptor_sd_instance_id(t, parent_sd, &rkey.parent_id);
+	if (!NT_STATUS_IS_OK(status)) {
+		DBG_ERR("descriptor_sd_instance_id() - %s\n",
+			nt_errstr(status));
+		return NULL;
+	}
+	status = descriptor_sd_instance_id(t, old_sd, &rkey.old_id);
+	if (!NT_STATUS_IS_OK(status)) {
+		DBG_ERR("descriptor_sd_instance_id() - %s\n",
+			nt_errstr(status));
+		return NULL;
+	}
+
+	key = make_tdb_data((const void *)&rkey, sizeof(rkey));
+	status = dbwrap_parse_record(t->sds.results, key,
+				     descriptor_sd_result_parser, &cached);
+	if (NT_STATUS_IS_OK(status)) {
+		t->sds.num_hits += 1;
+		return cached;
+	}
+	if (!NT_STATUS_EQUAL(status, NT_STATUS_NOT_FOUND)) {
+		DBG_ERR("dbwrap_parse_record() - %s\n",
+			nt_errstr(status));
+		return NULL;
+	}
+
+	t->sds.num_misses += 1;
+
+	/*
+	 * The stored descriptor always carries an owner
+	 * and a group, so the result doesn't depend on
+	 * the session or the dn of the object.
+	 */
+	sd = get_new_descriptor(module, dn, mem_ctx,
+				objectclass, parent_sd,
+				old_sd, old_sd, SECINFO_OWNER |
+				SECINFO_GROUP | SECINFO_DACL |
+				SECINFO_SACL);
+	if (sd == NULL) {
+		return NULL;
+	}
+
+	cached = talloc(t->mem, DATA_BLOB);
+	if (cached == NULL) {
+		return NULL;
+	}
+	*cached = data_blob_talloc(cached, sd->data, sd->length);
+	if (cached->data == NULL) {
+		TALLOC_FREE(cached);
+		return NULL;
+	}
+
+	val = make_tdb_data((const void *)&cached, sizeof(cached));
+	status = dbwrap_store(t->sds.results, key, val, TDB_INSERT);
+	if (!NT_STATUS_IS_OK(status)) {
+		DBG_ERR("dbwrap_store() - %s\n",
+			nt_errstr(status));
+		TALLOC_FREE(cached);
+		return NULL;
+	}
+
+	return cached;
+}
+
 static DATA_BLOB *descr_get_descriptor_to_show(struct ldb_module *module,
 					       TALLOC_CTX *mem_ctx,
 					       struct ldb_val *sd,
@@ -1057,9 +1251,18 @@ static int descriptor_modify(struct ldb_module *module, struct ldb_request *req)
 		user_sd = old_sd;
 	}
 
-	sd = get_new_descriptor(module, current_res->msgs[0]->dn, req,
-				objectclass, parent_sd,
-				user_sd, old_sd, sd_flags);
+	if (sd_propagation_control != NULL) {
+		sd = descriptor_get_propagated_sd(module,
+						  current_res->msgs[0]->dn,
+						  req,
+						  objectclass,
+						  parent_sd,
+						  old_sd);
+	} else {
+		sd = get_new_descriptor(module, current_res->msgs[0]->dn, req,
+					objectclass, parent_sd,
+					user_sd, old_sd, sd_flags);
+	}
 	if (sd == NULL) {
 		return ldb_operr(ldb);
 	}
@@ -1441,11 +1644,17 @@ static int descriptor_extended_sec_desc_propagation(struct ldb_module *module,
 	return ldb_module_done(req, NULL, NULL, LDB_SUCCESS);
 }
 
+static int descriptor_extended_sec_desc_propagation_batch(struct ldb_module *module,
+							  struct ldb_request *req);
+
 static int descriptor_extended(struct ldb_module *module, struct ldb_request *req)
 {
 	if (strcmp(req->op.extended.oid, DSDB_EXTENDED_SEC_DESC_PROPAGATION_OID) == 0) {
 		return descriptor_extended_sec_desc_propagation(module, req);
 	}
+	if (strcmp(req->op.extended.oid, DSDB_EXTENDED_SEC_DESC_PROPAGATION_BATCH_OID) == 0) {
+		return descriptor_extended_sec_desc_propagation_batch(module, req);
+	}
 
 	return ldb_next_request(module, req);
 }
@@ -1468,6 +1677,12 @@ static int descriptor_init(struct ldb_module *module)
 		ldb_oom(ldb);
 		return LDB_ERR_OPERATIONS_ERROR;
 	}
+	descriptor_private->batch_size = lpcfg_parm_int(
+		ldb_get_opaque(ldb, "loadparm"),
+		NULL,
+		"dsdb",
+		"sd propagation batch size",
+		0);
 	ldb_module_set_private(module, descriptor_private);
 
 	return ldb_next_init(module);
@@ -1655,6 +1870,125 @@ static int descriptor_sd_propagation_msg_sort(struct ldb_message **m1,
 	return ldb_dn_compare(dn2, dn1);
 }
 
+/*
+ * Append the given change to the persistent queue of
+ * the background propagation.
+ *
+ * Each value of "pendingPropagation" is "<objectGUID>;<nc_root>",
+ * "propagationCursor" holds the dn of the last object processed
+ * for the first pending value, in the order of
+ * descriptor_sd_propagation_walk().
+ */
+static int descriptor_sd_propagation_queue(struct ldb_module *module,
+					   struct descriptor_changes *change)
+{
+	struct descriptor_data *descriptor_private =
+		talloc_get_type_abort(ldb_module_get_private(module),
+		struct descriptor_data);
+	struct descriptor_transaction *t = &descriptor_private->transaction;
+	struct ldb_context *ldb = ldb_module_get_ctx(module);
+	static const char * const attrs[] = { "pendingPropagation",
+					      "propagationCursor", NULL };
+	TALLOC_CTX *tmp_ctx = NULL;
+	struct ldb_dn *queue_dn = NULL;
+	struct ldb_result *res = NULL;
+	struct ldb_message *msg = NULL;
+	struct ldb_message_element *el = NULL;
+	struct GUID_txt_buf guid_buf;
+	char *value = NULL;
+	struct ldb_val val;
+	int ret;
+
+	tmp_ctx = talloc_new(change);
+	if (tmp_ctx == NULL) {
+		return ldb_module_oom(module);
+	}
+
+	queue_dn = ldb_dn_new(tmp_ctx, ldb, DSDB_SD_PROPAGATION_QUEUE_DN);
+	if (queue_dn == NULL) {
+		TALLOC_FREE(tmp_ctx);
+		return ldb_module_oom(module);
+	}
+
+	value = talloc_asprintf(tmp_ctx, "%s;%s",
+				GUID_buf_string(&change->guid, &guid_buf),
+				ldb_dn_get_linearized(change->nc_root));
+	if (value == NULL) {
+		TALLOC_FREE(tmp_ctx);
+		return ldb_module_oom(module);
+	}
+	val = data_blob_string_const(value);
+
+	msg = ldb_msg_new(tmp_ctx);
+	if (msg == NULL) {
+		TALLOC_FREE(tmp_ctx);
+		return ldb_module_oom(module);
+	}
+	msg->dn = queue_dn;
+
+	ret = dsdb_module_search_dn(module, tmp_ctx, &res, queue_dn,
+				    attrs,
+				    DSDB_FLAG_NEXT_MODULE |
+				    DSDB_FLAG_AS_SYSTEM,
+				    NULL);
+	if (ret == LDB_ERR_NO_SUCH_OBJECT) {
+		ret = ldb_msg_add_string(msg, "pendingPropagation", value);
+		if (ret != LDB_SUCCESS) {
+			TALLOC_FREE(tmp_ctx);
+			return ret;
+		}
+		ret = dsdb_module_add(module, msg,
+				      DSDB_FLAG_NEXT_MODULE |
+				      DSDB_FLAG_AS_SYSTEM,
+				      NULL);
+		goto done;
+	}
+	if (ret != LDB_SUCCESS) {
+		TALLOC_FREE(tmp_ctx);
+		return ret;
+	}
+
+	el = ldb_msg_find_element(res->msgs[0], "pendingPropagation");
+	if (el != NULL && ldb_msg_find_val(el, &val) != NULL) {
+		if (el->num_values == 0 ||
+		    data_blob_cmp(&el->values[0], &val) != 0 ||
+		    ldb_msg_find_element(res->msgs[0],
+					 "propagationCursor") == NULL)
+		{
+			/*
+			 * Already queued and not yet started
+			 */
+			ret = LDB_SUCCESS;
+			goto done;
+		}
+
+		/*
+		 * The change is currently in progress,
+		 * start again from the top of the subtree.
+		 */
+		ret = ldb_msg_add_empty(msg, "propagationCursor",
+					LDB_FLAG_MOD_DELETE, NULL);
+	} else {
+		ret = ldb_msg_add_string_flags(msg, "pendingPropagation",
+					       value, LDB_FLAG_MOD_ADD);
+	}
+	if (ret != LDB_SUCCESS) {
+		TALLOC_FREE(tmp_ctx);
+		return ret;
+	}
+
+	ret = dsdb_module_modify(module, msg,
+				 DSDB_FLAG_NEXT_MODULE |
+				 DSDB_FLAG_AS_SYSTEM,
+				 NULL);
+done:
+	if (ret == LDB_SUCCESS) {
+		t->changes.num_queued += 1;
+	}
+	TALLOC_FREE(tmp_ctx);
+	return ret;
+}
+
 static int descriptor_sd_propagation_recursive(struct ldb_module *module,
 					       struct descriptor_changes *change)
 {
@@ -1797,6 +2131,18 @@ static int descriptor_sd_propagation_recursive(struct ldb_module *module,
 		return ret;
 	}
 
+	if (descriptor_private->batch_size > 0 &&
+	    res->count > descriptor_private->batch_size + 1)
+	{
+		/*
+		 * The subtree is too large to be processed
+		 * while we block all other writers, let the
+		 * background propagation handle it.
+		 */
+		TALLOC_FREE(res);
+		return descriptor_sd_propagation_queue(module, change);
+	}
+
 	TYPESAFE_QSORT(res->msgs, res->count,
 		       descriptor_sd_propagation_msg_sort);
 
@@ -1840,6 +2186,508 @@ static int descriptor_sd_propagation_recursive(struct ldb_module *module,
 	return LDB_SUCCESS;
 }
 
+/*
+ * Process the children of parent_dn and their subtrees in tree
+ * order, skipping all children up to and including after_dn.
+ *
+ * Each level is a ONELEVEL search, so a batch only looks at the
+ * objects it processes and at the ancestors of the cursor, rather
+ * than at the whole queued subtree.
+ */
+static int descriptor_sd_propagation_walk(struct ldb_module *module,
+					  TALLOC_CTX *mem_ctx,
+					  struct ldb_dn *parent_dn,
+					  struct ldb_dn *after_dn,
+					  uint32_t max_objects,
+					  uint32_t *num_processed,
+					  struct ldb_dn **last_dn,
+					  bool *done)
+{
+	TALLOC_CTX *tmp_ctx = NULL;
+	struct ldb_result *res = NULL;
+	const char * const no_attrs[] = { "@__NONE__", NULL };
+	unsigned int i;
+	int ret;
+	bool stop = false;
+
+	tmp_ctx = talloc_new(mem_ctx);
+	if (tmp_ctx == NULL) {
+		return ldb_module_oom(module);
+	}
+
+	ret = dsdb_module_search(module,
+				 tmp_ctx,
+				 &res,
+				 parent_dn,
+				 LDB_SCOPE_ONELEVEL,
+				 no_attrs,
+				 DSDB_FLAG_NEXT_MODULE |
+				 DSDB_FLAG_AS_SYSTEM |
+				 DSDB_SEARCH_SHOW_EXTENDED_DN,
+				 NULL, /* parent_req */
+				 "(objectClass=*)");
+	if (ret == LDB_ERR_NO_SUCH_OBJECT) {
+		/*
+		 * The object was removed since the last
+		 * batch, so there's nothing below it.
+		 */
+		TALLOC_FREE(tmp_ctx);
+		return LDB_SUCCESS;
+	}
+	if (ret != LDB_SUCCESS) {
+		TALLOC_FREE(tmp_ctx);
+		return ret;
+	}
+
+	TYPESAFE_QSORT(res->msgs, res->count,
+		       descriptor_sd_propagation_msg_sort);
+
+	for (i = 0; i < res->count; i++) {
+		if (after_dn != NULL &&
+		    ldb_dn_compare(after_dn, res->msgs[i]->dn) <= 0)
+		{
+			/*
+			 * Already done by an earlier batch
+			 */
+			continue;
+		}
+
+		if (*num_processed >= max_objects) {
+			*done = false;
+			break;
+		}
+
+		ret = descriptor_sd_propagation_object(module,
+						       res->msgs[i],
+						       &stop);
+		if (ret != LDB_SUCCESS) {
+			TALLOC_FREE(tmp_ctx);
+			return ret;
+		}
+
+		*num_processed += 1;
+		TALLOC_FREE(*last_dn);
+		*last_dn = ldb_dn_copy(mem_ctx, res->msgs[i]->dn);
+		if (*last_dn == NULL) {
+			TALLOC_FREE(tmp_ctx);
+			return ldb_module_oom(module);
+		}
+
+		ret = descriptor_sd_propagation_walk(module,
+						     mem_ctx,
+						     res->msgs[i]->dn,
+						     NULL,
+						     max_objects,
+						     num_processed,
+						     last_dn,
+						     done);
+		if (ret != LDB_SUCCESS) {
+			TALLOC_FREE(tmp_ctx);
+			return ret;
+		}
+		if (!*done) {
+			break;
+		}
+	}
+
+	TALLOC_FREE(tmp_ctx);
+	return LDB_SUCCESS;
+}
+
+/*
+ * Process up to max_objects objects below the object given by
+ * change, continuing after cursor_dn.
+ *
+ * Unlike descriptor_sd_propagation_recursive() we can't stop
+ * at unchanged objects, as their children may not have been
+ * processed by an earlier batch yet.
+ */
+static int descriptor_sd_propagation_batch(struct ldb_module *module,
+					   TALLOC_CTX *mem_ctx,
+					   struct descriptor_changes *change,
+					   struct ldb_dn *cursor_dn,
+					   uint32_t max_objects,
+					   uint32_t *num_processed,
+					   struct ldb_dn **last_dn,
+					   bool *done)
+{
+	struct ldb_context *ldb = ldb_module_get_ctx(module);
+	struct ldb_result *guid_res = NULL;
+	struct ldb_dn *guid_dn = NULL;
+	struct ldb_dn *top_dn = NULL;
+	struct ldb_dn *dn = NULL;
+	const char * const no_attrs[] = { "@__NONE__", NULL };
+	struct GUID_txt_buf guid_buf;
+	int ret;
+
+	*num_processed = 0;
+	*last_dn = NULL;
+	*done = true;
+
+	/*
+	 * The GUID is stable under rename, the nc_root
+	 * only routes the search to the right partition.
+	 */
+	guid_dn = ldb_dn_new_fmt(mem_ctx, ldb, "<GUID=%s>;%s",
+				 GUID_buf_string(&change->guid, &guid_buf),
+				 ldb_dn_get_linearized(change->nc_root));
+	if (guid_dn == NULL) {
+		return ldb_module_oom(module);
+	}
+
+	ret = dsdb_module_search_dn(module,
+				    mem_ctx,
+				    &guid_res,
+				    guid_dn,
+				    no_attrs,
+				    DSDB_FLAG_NEXT_MODULE |
+				    DSDB_FLAG_AS_SYSTEM,
+				    NULL);
+	TALLOC_FREE(guid_dn);
+	if (ret != LDB_SUCCESS) {
+		/*
+		 * LDB_ERR_NO_SUCH_OBJECT, the object was
+		 * removed since it was queued, there's
+		 * nothing left to do.
+		 */
+		return ret;
+	}
+	top_dn = guid_res->msgs[0]->dn;
+
+	if (cursor_dn == NULL ||
+	    ldb_dn_compare_base(top_dn, cursor_dn) != 0 ||
+	    ldb_dn_compare(top_dn, cursor_dn) == 0)
+	{
+		/*
+		 * Not started yet, or the subtree was
+		 * renamed since the last batch, start
+		 * from the top.
+		 */
+		ret = descriptor_sd_propagation_walk(module,
+						     mem_ctx,
+						     top_dn,
+						     NULL,
+						     max_objects,
+						     num_processed,
+						     last_dn,
+						     done);
+		TALLOC_FREE(guid_res);
+		return ret;
+	}
+
+	/*
+	 * First whatever is below the last object of
+	 * the previous batch, then the later siblings
+	 * of it and each of its parents.
+	 */
+	ret = descriptor_sd_propagation_walk(module,
+					     mem_ctx,
+					     cursor_dn,
+					     NULL,
+					     max_objects,
+					     num_processed,
+					     last_dn,
+					     done);
+
+	dn = cursor_dn;
+	while (ret == LDB_SUCCESS && *done &&
+	       ldb_dn_compare(top_dn, dn) != 0)
+	{
+		struct ldb_dn *parent_dn = ldb_dn_get_parent(mem_ctx, dn);
+		if (parent_dn == NULL) {
+			TALLOC_FREE(guid_res);
+			return ldb_module_oom(module);
+		}
+
+		ret = descriptor_sd_propagation_walk(module,
+						     mem_ctx,
+						     parent_dn,
+						     dn,
+						     max_objects,
+						     num_processed,
+						     last_dn,
+						     done);
+		dn = parent_dn;
+	}
+
+	TALLOC_FREE(guid_res);
+	return ret;
+}
+
+static int descriptor_extended_sec_desc_propagation_batch(struct ldb_module *module,
+							  struct ldb_request *req)
+{
+	struct descriptor_data *descriptor_private =
+		talloc_get_type_abort(ldb_module_get_private(module),
+		struct descriptor_data);
+	struct descriptor_transaction *t = &descriptor_private->transaction;
+	struct ldb_context *ldb = ldb_module_get_ctx(module);
+	struct dsdb_extended_sec_desc_propagation_batch *op = NULL;
+	static const char * const attrs[] = { "pendingPropagation",
+					      "propagationCursor", NULL };
+	TALLOC_CTX *tmp_ctx = NULL;
+	struct ldb_dn *queue_dn = NULL;
+	struct ldb_result *res = NULL;
+	struct ldb_message *msg = NULL;
+	struct ldb_message_element *el = NULL;
+	struct descriptor_changes *change = NULL;
+	struct ldb_dn *cursor_dn = NULL;
+	struct ldb_dn *last_dn = NULL;
+	const char *cursor = NULL;
+	char *head = NULL;
+	char *p = NULL;
+	uint32_t max_objects;
+	bool done = true;
+	NTSTATUS status;
+	int ret;
+
+	op = talloc_get_type(req->op.extended.data,
+			     struct dsdb_extended_sec_desc_propagation_batch);
+	if (op == NULL) {
+		ldb_debug(ldb, LDB_DEBUG_FATAL,
+			  "descriptor_extended_sec_desc_propagation_batch: "
+			  "invalid extended data\n");
+		return LDB_ERR_PROTOCOL_ERROR;
+	}
+
+	if (ldb_req_is_untrusted(req)) {
+		return ldb_module_error(module,
+					LDB_ERR_UNWILLING_TO_PERFORM,
+					"sd propagation batch not allowed "
+					"from untrusted request");
+	}
+
+	if (t->mem == NULL) {
+		return ldb_module_operr(module);
+	}
+
+	op->num_processed = 0;
+	op->num_pending = 0;
+
+	max_objects = op->max_objects;
+	if (max_objects == 0) {
+		max_objects = descriptor_private->batch_size;
+	}
+	if (max_objects == 0) {
+		max_objects = UINT32_MAX;
+	}
+
+	tmp_ctx = talloc_new(req);
+	if (tmp_ctx == NULL) {
+		return ldb_module_oom(module);
+	}
+
+	queue_dn = ldb_dn_new(tmp_ctx, ldb, DSDB_SD_PROPAGATION_QUEUE_DN);
+	if (queue_dn == NULL) {
+		TALLOC_FREE(tmp_ctx);
+		return ldb_module_oom(module);
+	}
+
+	ret = dsdb_module_search_dn(module, tmp_ctx, &res, queue_dn,
+				    attrs,
+				    DSDB_FLAG_NEXT_MODULE |
+				    DSDB_FLAG_AS_SYSTEM,
+				    req);
+	if (ret == LDB_ERR_NO_SUCH_OBJECT) {
+		TALLOC_FREE(tmp_ctx);
+		ldb_reset_err_string(ldb);
+		return ldb_module_done(req, NULL, NULL, LDB_SUCCESS);
+	}
+	if (ret != LDB_SUCCESS) {
+		TALLOC_FREE(tmp_ctx);
+		return ret;
+	}
+
+	el = ldb_msg_find_element(res->msgs[0], "pendingPropagation");
+	if (el == NULL || el->num_values == 0) {
+		TALLOC_FREE(tmp_ctx);
+		return ldb_module_done(req, NULL, NULL, LDB_SUCCESS);
+	}
+	op->num_pending = el->num_values;
+
+	if (op->requeue_head) {
+		if (el->num_values == 1) {
+			/*
+			 * Nothing else to do first, it's
+			 * retried from where it stopped.
+			 */
+			TALLOC_FREE(tmp_ctx);
+			return ldb_module_done(req, NULL, NULL, LDB_SUCCESS);
+		}
+
+		DBG_WARNING("Moving pendingPropagation value [%.*s] "
+			    "to the end of the queue\n",
+			    (int)el->values[0].length,
+			    (const char *)el->values[0].data);
+
+		msg = ldb_msg_new(tmp_ctx);
+		if (msg == NULL) {
+			TALLOC_FREE(tmp_ctx);
+			return ldb_module_oom(module);
+		}
+		msg->dn = queue_dn;
+
+		ret = ldb_msg_append_value(msg, "pendingPropagation",
+					   &el->values[0],
+					   LDB_FLAG_MOD_DELETE);
+		if (ret != LDB_SUCCESS) {
+			TALLOC_FREE(tmp_ctx);
+			return ret;
+		}
+		ret = ldb_msg_append_value(msg, "pendingPropagation",
+					   &el->values[0],
+					   LDB_FLAG_MOD_ADD);
+		if (ret != LDB_SUCCESS) {
+			TALLOC_FREE(tmp_ctx);
+			return ret;
+		}
+		if (ldb_msg_find_element(res->msgs[0],
+					 "propagationCursor") != NULL)
+		{
+			/*
+			 * The cursor belongs to the first
+			 * value, start over when we get back
+			 * to this one.
+			 */
+			ret = ldb_msg_add_empty(msg, "propagationCursor",
+						LDB_FLAG_MOD_DELETE, NULL);
+			if (ret != LDB_SUCCESS) {
+				TALLOC_FREE(tmp_ctx);
+				return ret;
+			}
+		}
+
+		ret = dsdb_module_modify(module, msg,
+					 DSDB_FLAG_NEXT_MODULE |
+					 DSDB_FLAG_AS_SYSTEM,
+					 req);
+		TALLOC_FREE(tmp_ctx);
+		if (ret != LDB_SUCCESS) {
+			return ret;
+		}
+		return ldb_module_done(req, NULL, NULL, LDB_SUCCESS);
+	}
+
+	change = talloc_zero(tmp_ctx, struct descriptor_changes);
+	if (change == NULL) {
+		TALLOC_FREE(tmp_ctx);
+		return ldb_module_oom(module);
+	}
+
+	head = talloc_strndup(tmp_ctx,
+			      (const char *)el->values[0].data,
+			      el->values[0].length);
+	if (head == NULL) {
+		TALLOC_FREE(tmp_ctx);
+		return ldb_module_oom(module);
+	}
+
+	p = strchr(head, ';');
+	if (p == NULL) {
+		status = NT_STATUS_INVALID_PARAMETER;
+	} else {
+		*p = '\0';
+		status = GUID_from_string(head, &change->guid);
+	}
+	if (NT_STATUS_IS_OK(status)) {
+		change->nc_root = ldb_dn_new(change, ldb, p + 1);
+		if (!ldb_dn_validate(change->nc_root)) {
+			status = NT_STATUS_INVALID_PARAMETER;
+		}
+	}
+
+	if (!NT_STATUS_IS_OK(status)) {
+		DBG_ERR("Dropping invalid pendingPropagation value "
+			"[%.*s] - %s\n",
+			(int)el->values[0].length,
+			(const char *)el->values[0].data,
+			nt_errstr(status));
+		ret = LDB_ERR_NO_SUCH_OBJECT;
+	} else {
+		cursor = ldb_msg_find_attr_as_string(res->msgs[0],
+						     "propagationCursor",
+						     NULL);
+		if (cursor != NULL) {
+			cursor_dn = ldb_dn_new(tmp_ctx, ldb, cursor);
+			if (!ldb_dn_validate(cursor_dn)) {
+				cursor_dn = NULL;
+			}
+		}
+
+		ret = descriptor_sd_propagation_batch(module,
+						      tmp_ctx,
+						      change,
+						      cursor_dn,
+						      max_objects,
+						      &op->num_processed,
+						      &last_dn,
+						      &done);
+	}
+	if (ret == LDB_ERR_NO_SUCH_OBJECT) {
+		ldb_reset_err_string(ldb);
+		done = true;
+		ret = LDB_SUCCESS;
+	}
+	if (ret != LDB_SUCCESS) {
+		TALLOC_FREE(tmp_ctx);
+		return ret;
+	}
+
+	msg = ldb_msg_new(tmp_ctx);
+	if (msg == NULL) {
+		TALLOC_FREE(tmp_ctx);
+		return ldb_module_oom(module);
+	}
+	msg->dn = queue_dn;
+
+	if (done) {
+		ret = ldb_msg_add_value(msg, "pendingPropagation",
+					&el->values[0], NULL);
+		if (ret != LDB_SUCCESS) {
+			TALLOC_FREE(tmp_ctx);
+			return ret;
+		}
+		msg->elements[0].flags = LDB_FLAG_MOD_DELETE;
+
+		if (cursor != NULL) {
+			ret = ldb_msg_add_empty(msg, "propagationCursor",
+						LDB_FLAG_MOD_DELETE, NULL);
+			if (ret != LDB_SUCCESS) {
+				TALLOC_FREE(tmp_ctx);
+				return ret;
+			}
+		}
+
+		op->num_pending -= 1;
+	} else {
+		ret = ldb_msg_add_string_flags(msg, "propagationCursor",
+					       ldb_dn_get_linearized(last_dn),
+					       LDB_FLAG_MOD_REPLACE);
+		if (ret != LDB_SUCCESS) {
+			TALLOC_FREE(tmp_ctx);
+			return ret;
+		}
+	}
+
+	ret = dsdb_module_modify(module, msg,
+				 DSDB_FLAG_NEXT_MODULE |
+				 DSDB_FLAG_AS_SYSTEM,
+				 req);
+	if (ret != LDB_SUCCESS) {
+		TALLOC_FREE(tmp_ctx);
+		return ret;
+	}
+
+	DBG_NOTICE("Processed %"PRIu32" objects below %s, "
+		   "%"PRIu32" subtrees pending\n",
+		   op->num_processed,
+		   GUID_string(tmp_ctx, &change->guid),
+		   op->num_pending);
+
+	TALLOC_FREE(tmp_ctx);
+	return ldb_module_done(req, NULL, NULL, LDB_SUCCESS);
+}
+
 static int descriptor_start_transaction(struct ldb_module *module)
 {
 	struct descriptor_data *descriptor_private =
@@ -1868,6 +2716,18 @@ static int descriptor_start_transaction(struct ldb_module *module)
 		*t = (struct descriptor_transaction) { .mem = NULL, };
 		return ldb_module_oom(module);
 	}
+	t->sds.instances = db_open_rbt(t->mem);
+	if (t->sds.instances == NULL) {
+		TALLOC_FREE(t->mem);
+		*t = (struct descriptor_transaction) { .mem = NULL, };
+		return ldb_module_oom(module);
+	}
+	t->sds.results = db_open_rbt(t->mem);
+	if (t->sds.results == NULL) {
+		TALLOC_FREE(t->mem);
+		*t = (struct descriptor_transaction) { .mem = NULL, };
+		return ldb_module_oom(module);
+	}
 
 	return ldb_next_start_trans(module);
 }
@@ -2016,8 +2876,12 @@ static int descriptor_prepare_commit(struct ldb_module *module)
 	}
 
 	DBG_NOTICE("changes: num_processed=%zu\n", t->changes.num_processed);
+	DBG_NOTICE("changes: num_queued=%zu\n", t->changes.num_queued);
 	DBG_NOTICE("objects: num_processed=%zu\n", t->objects.num_processed);
 	DBG_NOTICE("objects: num_skipped=%zu\n", t->objects.num_skipped);
+	DBG_NOTICE("sds: num_instances=%"PRIu32"\n", t->sds.num_instances);
+	DBG_NOTICE("sds: num_hits=%zu\n", t->sds.num_hits);
+	DBG_NOTICE("sds: num_misses=%zu\n", t->sds.num_misses);
 
 	return ldb_next_prepare_commit(module);
 }
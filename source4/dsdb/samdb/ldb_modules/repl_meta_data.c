@@ -82,6 +82,12 @@ struct replmd_private {
 	uint32_t num_processed;
 	bool recyclebin_enabled;
 	bool recyclebin_state_known;
+	/*
+	 * link targets prefetched for the la_group currently being
+	 * applied, sorted by GUID
+	 */
+	struct replmd_la_target *la_targets;
+	uint32_t num_la_targets;
 };
 
 /*
@@ -190,6 +196,17 @@ enum deletion_state {
 	OBJECT_REMOVED=5
 };
 
+/*
+ * the result of looking up a link target by GUID, shared by all the
+ * links in an la_group (see replmd_prefetch_la_targets())
+ */
+struct replmd_la_target {
+	struct GUID guid;
+	struct ldb_dn *dn;
+	enum deletion_state deletion_state;
+	uint32_t num_found;
+};
+
 static bool replmd_recyclebin_enabled(struct ldb_module *module)
 {
 	bool enabled = false;
@@ -357,6 +374,8 @@ static void replmd_txn_cleanup(struct replmd_private *replmd_private)
 	talloc_free(replmd_private->la_ctx);
 	replmd_private->la_list = NULL;
 	replmd_private->la_ctx = NULL;
+	replmd_private->la_targets = NULL;
+	replmd_private->num_la_targets = 0;
 	replmd_private->recyclebin_state_known = false;
 }
 
@@ -7703,6 +7722,38 @@ static int replmd_allow_missing_target(struct ldb_module *module,
 	return LDB_SUCCESS;
 }
 
+#define REPLMD_LA_TARGET_GUID_CMP(guid, target_guid) \
+	GUID_compare(guid, &(target_guid))
+
+/*
+ * Returns the prefetched details of a link target, if we have an
+ * unambiguous, non-recycled match for it. Anything else is left to
+ * the normal lookup in replmd_check_target_exists().
+ */
+static const struct replmd_la_target *replmd_la_target_find(struct ldb_module *module,
+							    const struct GUID *guid)
+{
+	struct replmd_private *replmd_private =
+		talloc_get_type_abort(ldb_module_get_private(module),
+				      struct replmd_private);
+	struct replmd_la_target *target = NULL;
+
+	BINARY_ARRAY_SEARCH(replmd_private->la_targets,
+			    replmd_private->num_la_targets,
+			    guid, guid, REPLMD_LA_TARGET_GUID_CMP, target);
+	if (target == NULL) {
+		return NULL;
+	}
+	if (target->num_found != 1) {
+		return NULL;
+	}
+	if (target->deletion_state >= OBJECT_RECYCLED) {
+		return NULL;
+	}
+
+	return target;
+}
+
 /**
  * Checks that the target object for a linked attribute exists.
  * @param guid returns the target object's GUID (is returned)if it exists)
@@ -7730,6 +7781,20 @@ static int replmd_check_target_exists(struct ldb_module *module,
 	*ignore_link = false;
 	ntstatus = dsdb_get_extended_dn_guid(dsdb_dn->dn, guid, "GUID");
 
+	if (NT_STATUS_IS_OK(ntstatus)) {
+		const struct replmd_la_target *target = NULL;
+
+		target = replmd_la_target_find(module, guid);
+		if (target != NULL) {
+			dsdb_dn->dn = ldb_dn_copy(dsdb_dn, target->dn);
+			talloc_free(tmp_ctx);
+			if (dsdb_dn->dn == NULL) {
+				return ldb_module_oom(module);
+			}
+			return LDB_SUCCESS;
+		}
+	}
+
 	if (!NT_STATUS_IS_OK(ntstatus) && !active) {
 
 		/*
@@ -8491,6 +8556,159 @@ static int replmd_start_transaction(struct ldb_module *module)
 	return ldb_next_start_trans(module);
 }
 
+/* the number of link targets we look up in a single search */
+#define REPLMD_LA_TARGET_BATCH_SIZE 100
+
+static int replmd_la_target_cmp(const struct replmd_la_target *t1,
+				const struct replmd_la_target *t2)
+{
+	return GUID_compare(&t1->guid, &t2->guid);
+}
+
+/*
+ * Looks up the target objects of all the links in an la_group with
+ * a few batched GUID searches, rather than one search per link. The
+ * results are used by replmd_check_target_exists() while the group
+ * is applied.
+ *
+ * Nothing here is fatal: any target we fail to find is looked up
+ * again (and any error reported) by the normal per-link path.
+ */
+static int replmd_prefetch_la_targets(struct ldb_module *module,
+				      TALLOC_CTX *mem_ctx,
+				      struct replmd_private *replmd_private,
+				      struct la_group *la_group,
+				      const struct dsdb_attribute *attr)
+{
+	struct ldb_context *ldb = ldb_module_get_ctx(module);
+	const struct dsdb_schema *schema = dsdb_get_schema(ldb, mem_ctx);
+	const char *attrs[] = { "objectGUID", "isDeleted", "isRecycled", NULL };
+	struct replmd_la_target *targets = NULL;
+	struct la_entry *la = NULL;
+	uint32_t num_links = 0;
+	uint32_t num_targets = 0;
+	uint32_t i, j;
+
+	/* never leave the targets of a previous group behind */
+	replmd_private->la_targets = NULL;
+	replmd_private->num_la_targets = 0;
+
+	for (la = la_group->la_entries; la != NULL; la = la->next) {
+		num_links++;
+	}
+
+	if (num_links < 2) {
+		return LDB_SUCCESS;
+	}
+
+	targets = talloc_array(mem_ctx, struct replmd_la_target, num_links);
+	if (targets == NULL) {
+		return ldb_module_oom(module);
+	}
+
+	for (la = la_group->la_entries; la != NULL; la = la->next) {
+		struct replmd_la_target *t = &targets[num_targets];
+		struct dsdb_dn *dsdb_dn = NULL;
+		WERROR status;
+		NTSTATUS ntstatus;
+
+		status = dsdb_dn_la_from_blob(ldb, attr, schema, targets,
+					      la->la->value.blob, &dsdb_dn);
+		if (!W_ERROR_IS_OK(status)) {
+			continue;
+		}
+
+		ntstatus = dsdb_get_extended_dn_guid(dsdb_dn->dn, &t->guid,
+						     "GUID");
+		TALLOC_FREE(dsdb_dn);
+		if (!NT_STATUS_IS_OK(ntstatus)) {
+			continue;
+		}
+
+		t->dn = NULL;
+		t->deletion_state = OBJECT_REMOVED;
+		t->num_found = 0;
+		num_targets++;
+	}
+
+	if (num_targets == 0) {
+		TALLOC_FREE(targets);
+		return LDB_SUCCESS;
+	}
+
+	TYPESAFE_QSORT(targets, num_targets, replmd_la_target_cmp);
+
+	/* a group often holds several links to the same target */
+	for (i = 1, j = 0; i < num_targets; i++) {
+		if (!GUID_equal(&targets[i].guid, &targets[j].guid)) {
+			targets[++j] = targets[i];
+		}
+	}
+	num_targets = j + 1;
+
+	for (i = 0; i < num_targets; i += REPLMD_LA_TARGET_BATCH_SIZE) {
+		uint32_t end = MIN(num_targets, i + REPLMD_LA_TARGET_BATCH_SIZE);
+		struct ldb_result *res = NULL;
+		char *filter = NULL;
+		int ret;
+
+		filter = talloc_strdup(targets, "(|");
+		for (j = i; j < end; j++) {
+			struct GUID_txt_buf guid_str;
+
+			talloc_asprintf_addbuf(&filter, "(objectGUID=%s)",
+					       GUID_buf_string(&targets[j].guid,
+							       &guid_str));
+		}
+		talloc_asprintf_addbuf(&filter, ")");
+		if (filter == NULL) {
+			TALLOC_FREE(targets);
+			return ldb_module_oom(module);
+		}
+
+		ret = dsdb_module_search(module, targets, &res,
+					 NULL, LDB_SCOPE_SUBTREE,
+					 attrs,
+					 DSDB_FLAG_NEXT_MODULE |
+					 DSDB_SEARCH_SHOW_RECYCLED |
+					 DSDB_SEARCH_SEARCH_ALL_PARTITIONS |
+					 DSDB_SEARCH_SHOW_DN_IN_STORAGE_FORMAT,
+					 NULL,
+					 "%s", filter);
+		TALLOC_FREE(filter);
+		if (ret != LDB_SUCCESS) {
+			DBG_INFO("Failed to prefetch %u link targets: %s\n",
+				 end - i, ldb_errstring(ldb));
+			break;
+		}
+
+		for (j = 0; j < res->count; j++) {
+			struct ldb_message *msg = res->msgs[j];
+			struct replmd_la_target *t = NULL;
+			struct GUID guid;
+
+			guid = samdb_result_guid(msg, "objectGUID");
+			BINARY_ARRAY_SEARCH(targets, num_targets, guid, &guid,
+					    REPLMD_LA_TARGET_GUID_CMP, t);
+			if (t == NULL) {
+				continue;
+			}
+
+			t->num_found++;
+			t->dn = talloc_steal(targets, msg->dn);
+			replmd_deletion_state(module, msg,
+					      &t->deletion_state, NULL);
+		}
+
+		TALLOC_FREE(res);
+	}
+
+	replmd_private->la_targets = targets;
+	replmd_private->num_la_targets = num_targets;
+
+	return LDB_SUCCESS;
+}
+
 /**
  * Processes a group of linked attributes that apply to the same source-object
  * and attribute-ID (and were received in the same replication chunk).
@@ -8578,6 +8796,16 @@ static int replmd_process_la_group(struct ldb_module *module,
 		old_el->flags = LDB_FLAG_MOD_REPLACE;
 	}
 
+	/*
+	 * resolve all the link targets up front, rather than with a
+	 * separate GUID search for each link
+	 */
+	ret = replmd_prefetch_la_targets(module, tmp_ctx, replmd_private,
+					 la_group, attr);
+	if (ret != LDB_SUCCESS) {
+		goto clear_la_targets;
+	}
+
 	/*
 	 * go through and process the link target value(s) for this particular
 	 * source object and attribute. For optimization, the same msg is used
@@ -8604,7 +8832,7 @@ static int replmd_process_la_group(struct ldb_module *module,
 							NULL);
 
 			if (ret != LDB_SUCCESS) {
-				return ret;
+				goto clear_la_targets;
 			}
 		}
 		ret = replmd_process_linked_attribute(module, tmp_ctx,
@@ -8614,7 +8842,7 @@ static int replmd_process_la_group(struct ldb_module *module,
 						      pdn_list, &change_type);
 		if (ret != LDB_SUCCESS) {
 			replmd_txn_cleanup(replmd_private);
-			return ret;
+			goto clear_la_targets;
 		}
 
 		/*
@@ -8636,6 +8864,14 @@ static int replmd_process_la_group(struct ldb_module *module,
 		}
 	}
 
+clear_la_targets:
+	/* the prefetched targets live on tmp_ctx */
+	replmd_private->la_targets = NULL;
+	replmd_private->num_la_targets = 0;
+	if (ret != LDB_SUCCESS) {
+		return ret;
+	}
+
 	/*
 	 * it's possible we're already up-to-date and so don't need to modify
 	 * the object at all (e.g. doing a 'drs replicate --full-sync')
@@ -365,6 +365,27 @@ struct dsdb_extended_allocate_rid {
 
 #define DSDB_EXTENDED_SCHEMA_LOAD "1.3.6.1.4.1.7165.4.4.10"
 
+/*
+ * Processes the next batch of the queued background
+ * security descriptor propagation, must be called
+ * within a transaction.
+ *
+ * With requeue_head the first pending subtree is moved
+ * to the end of the queue instead, so that one failing
+ * subtree does not block all others.
+ */
+#define DSDB_EXTENDED_SEC_DESC_PROPAGATION_BATCH_OID "1.3.6.1.4.1.7165.4.4.11"
+struct dsdb_extended_sec_desc_propagation_batch {
+	/* in */
+	uint32_t max_objects;
+	bool requeue_head;
+	/* out */
+	uint32_t num_processed;
+	uint32_t num_pending;
+};
+
+#define DSDB_SD_PROPAGATION_QUEUE_DN "@SD_PROPAGATION"
+
 #define DSDB_OPENLDAP_DEREFERENCE_CONTROL "1.3.6.1.4.1.4203.666.5.16"
 
 struct dsdb_openldap_dereference {
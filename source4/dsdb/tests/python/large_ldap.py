@@ -111,6 +111,76 @@ class ManyLDAPTest(samba.tests.TestCase):
         # Check we got everything
         self.assertEqual(count, 2001)
 
+class MixedSizeLDAPTest(samba.tests.TestCase):
+    """Entries larger than half a reply batch buffer are queued
+    unbatched, the small entries following them must still start
+    a new batch buffer."""
+
+    @classmethod
+    def setUpClass(cls):
+        super().setUpClass()
+        cls.ldb = SamDB(url, credentials=creds, session_info=system_session(lp), lp=lp)
+        cls.base_dn = cls.ldb.domain_dn()
+        cls.OU_NAME = "mixed_ou" + format(random.randint(0, 99999), "05")
+        cls.ou_dn = ldb.Dn(cls.ldb, "ou=" + cls.OU_NAME + "," + str(cls.base_dn))
+        # LDAP_SERVER_REPLY_BATCH_SIZE is 64KiB
+        cls.photo = b'p' * (48 * 1024)
+
+        samba.tests.delete_force(cls.ldb, cls.ou_dn,
+                                 controls=['tree_delete:1'])
+
+        cls.ldb.add({
+            "dn": cls.ou_dn,
+            "objectclass": "organizationalUnit",
+            "ou": cls.OU_NAME})
+
+        for x in range(3):
+            user_name = "mixed%d-big" % x
+            cls.ldb.add({
+                "dn": "cn=" + user_name + "," + str(cls.ou_dn),
+                "objectclass": "user",
+                "sAMAccountName": user_name + format(random.randint(0, 99999), "05"),
+                "jpegPhoto": cls.photo})
+
+            for y in range(50):
+                ou_name = "mixed%d-small%02d" % (x, y)
+                cls.ldb.add({
+                    "dn": "ou=" + ou_name + "," + str(cls.ou_dn),
+                    "objectclass": "organizationalUnit",
+                    "ou": ou_name})
+
+    @classmethod
+    def tearDownClass(cls):
+        samba.tests.delete_force(cls.ldb, cls.ou_dn,
+                                 controls=['tree_delete:1'])
+
+    def test_large_entry_then_small_entries(self):
+        """Each large entry is followed by small ones and the done reply"""
+        if not url.startswith("ldap"):
+            self.fail(msg="This test is only valid on ldap")
+
+        res = self.ldb.search(base=self.ou_dn,
+                              scope=ldb.SCOPE_ONELEVEL,
+                              attrs=["name", "jpegPhoto"],
+                              controls=["server_sort:1:0:name"])
+
+        names = [str(msg["name"][0]) for msg in res]
+        self.assertEqual(names, sorted(names))
+        self.assertEqual(len(res), 3 * 51)
+
+        for msg in res:
+            if str(msg["name"][0]).endswith("-big"):
+                self.assertEqual(msg["jpegPhoto"][0], self.photo)
+            else:
+                self.assertNotIn("jpegPhoto", msg)
+
+        # The connection must still be usable afterwards
+        res = self.ldb.search(base=self.ou_dn,
+                              scope=ldb.SCOPE_BASE,
+                              attrs=["ou"])
+        self.assertEqual(len(res), 1)
+
+
 class LargeLDAPTest(samba.tests.TestCase):
 
     @classmethod
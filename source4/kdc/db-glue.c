@@ -36,6 +36,7 @@
 #include "lib/crypto/gkdi.h"
 #include "../lib/crypto/md4.h"
 #include "lib/util/memory.h"
+#include "lib/util/dlinklist.h"
 #include "system/kerberos.h"
 #include "auth/kerberos/kerberos.h"
 #include "kdc/authn_policy_util.h"
@@ -85,6 +86,188 @@ static const char * const trust_attrs[] = {
 	NULL
 };
 
+/*
+ * A small cache of the krbtgt and server account search results, so
+ * that a burst of AS-REQ and TGS-REQ packets does not repeat the same
+ * LDB searches over and over.
+ *
+ * Entries are only valid while the sam.ldb sequence number is
+ * unchanged, and for at most 'kdc:entry cache ttl' seconds, as
+ * msDS-User-Account-Control-Computed depends on the current time.
+ * Group managed service accounts are never cached, as their keys
+ * depend on the time of the request.
+ */
+struct samba_kdc_msg_cache_entry {
+	struct samba_kdc_msg_cache_entry *prev, *next;
+	const char *key;
+	uint64_t seq_num;
+	time_t expires;
+	struct ldb_dn *realm_dn;
+	struct ldb_message *msg;
+};
+
+struct samba_kdc_msg_cache {
+	struct samba_kdc_msg_cache_entry *entries;
+	unsigned int num_entries;
+	unsigned int max_entries;
+	int ttl;
+	uint64_t hits;
+	uint64_t misses;
+};
+
+static struct samba_kdc_msg_cache *samba_kdc_msg_cache_init(TALLOC_CTX *mem_ctx,
+							    struct loadparm_context *lp_ctx)
+{
+	struct samba_kdc_msg_cache *cache = NULL;
+	int ttl;
+	int max_entries;
+
+	ttl = lpcfg_parm_int(lp_ctx, NULL, "kdc", "entry cache ttl", 5);
+	max_entries = lpcfg_parm_int(lp_ctx, NULL, "kdc", "entry cache size", 128);
+	if (ttl <= 0 || max_entries <= 0) {
+		return NULL;
+	}
+
+	cache = talloc_zero(mem_ctx, struct samba_kdc_msg_cache);
+	if (cache == NULL) {
+		return NULL;
+	}
+	cache->ttl = ttl;
+	cache->max_entries = max_entries;
+
+	return cache;
+}
+
+/*
+ * Look up a cached search result. On a miss, *seq_num is set to the
+ * sequence number to pass to samba_kdc_msg_cache_store() once the
+ * search has been done, and *seq_valid says if that is possible.
+ */
+static bool samba_kdc_msg_cache_fetch(struct samba_kdc_db_context *kdc_db_ctx,
+				      TALLOC_CTX *mem_ctx,
+				      const char *key,
+				      uint64_t *seq_num,
+				      bool *seq_valid,
+				      struct ldb_dn **realm_dn,
+				      struct ldb_message **msg)
+{
+	struct samba_kdc_msg_cache *cache = kdc_db_ctx->msg_cache;
+	struct samba_kdc_msg_cache_entry *e = NULL;
+	struct ldb_message *msg_copy = NULL;
+	struct ldb_dn *realm_dn_copy = NULL;
+	time_t now;
+	int ret;
+
+	*seq_valid = false;
+
+	if (cache == NULL) {
+		return false;
+	}
+
+	ret = ldb_sequence_number(kdc_db_ctx->samdb, LDB_SEQ_HIGHEST_SEQ,
+				  seq_num);
+	if (ret != LDB_SUCCESS) {
+		return false;
+	}
+	*seq_valid = true;
+
+	now = time(NULL);
+
+	for (e = cache->entries; e != NULL; e = e->next) {
+		if (strcmp(e->key, key) == 0) {
+			break;
+		}
+	}
+
+	if (e == NULL) {
+		cache->misses++;
+		return false;
+	}
+
+	if (e->seq_num != *seq_num || e->expires < now) {
+		DLIST_REMOVE(cache->entries, e);
+		cache->num_entries--;
+		TALLOC_FREE(e);
+		cache->misses++;
+		return false;
+	}
+
+	msg_copy = ldb_msg_copy(mem_ctx, e->msg);
+	if (msg_copy == NULL) {
+		return false;
+	}
+	if (realm_dn != NULL && e->realm_dn != NULL) {
+		realm_dn_copy = ldb_dn_copy(mem_ctx, e->realm_dn);
+		if (realm_dn_copy == NULL) {
+			TALLOC_FREE(msg_copy);
+			return false;
+		}
+	}
+
+	DLIST_PROMOTE(cache->entries, e);
+	cache->hits++;
+
+	if ((cache->hits % 10000) == 0) {
+		DBG_INFO("KDC entry cache: %"PRIu64" hits, %"PRIu64" misses\n",
+			 cache->hits, cache->misses);
+	}
+
+	*msg = msg_copy;
+	if (realm_dn != NULL) {
+		*realm_dn = realm_dn_copy;
+	}
+	return true;
+}
+
+static void samba_kdc_msg_cache_store(struct samba_kdc_db_context *kdc_db_ctx,
+				      const char *key,
+				      uint64_t seq_num,
+				      bool seq_valid,
+				      struct ldb_dn *realm_dn,
+				      const struct ldb_message *msg)
+{
+	struct samba_kdc_msg_cache *cache = kdc_db_ctx->msg_cache;
+	struct samba_kdc_msg_cache_entry *e = NULL;
+
+	if (cache == NULL || !seq_valid) {
+		return;
+	}
+
+	if (ldb_msg_find_element(msg, "msDS-ManagedPasswordId") != NULL) {
+		return;
+	}
+
+	e = talloc_zero(cache, struct samba_kdc_msg_cache_entry);
+	if (e == NULL) {
+		return;
+	}
+
+	e->key = talloc_strdup(e, key);
+	e->msg = ldb_msg_copy(e, msg);
+	if (realm_dn != NULL) {
+		e->realm_dn = ldb_dn_copy(e, realm_dn);
+	}
+	if (e->key == NULL || e->msg == NULL ||
+	    (realm_dn != NULL && e->realm_dn == NULL)) {
+		TALLOC_FREE(e);
+		return;
+	}
+	e->seq_num = seq_num;
+	e->expires = time(NULL) + cache->ttl;
+
+	DLIST_ADD(cache->entries, e);
+	cache->num_entries++;
+
+	while (cache->num_entries > cache->max_entries) {
+		struct samba_kdc_msg_cache_entry *last =
+			DLIST_TAIL(cache->entries);
+
+		DLIST_REMOVE(cache->entries, last);
+		cache->num_entries--;
+		TALLOC_FREE(last);
+	}
+}
+
 /*
   send a message to the drepl server telling it to initiate a
   REPL_SECRET getncchanges extended op to fetch the users secrets
@@ -1284,6 +1467,9 @@ static krb5_error_code samba_kdc_message2entry(krb5_context context,
 	}
 
 	p->is_rodc = is_rodc;
+	/* Only clients are looked up with the full user_attrs */
+	p->user_attrs_loaded = (ent_type == SAMBA_KDC_ENT_TYPE_CLIENT ||
+				ent_type == SAMBA_KDC_ENT_TYPE_ANY);
 	p->kdc_db_ctx = kdc_db_ctx;
 	p->realm_dn = talloc_reference(p, realm_dn);
 	if (!p->realm_dn) {
@@ -3062,10 +3248,29 @@ static krb5_error_code samba_kdc_fetch_krbtgt(krb5_context context,
 		}
 
 		if (krbtgt_number == kdc_db_ctx->my_krbtgt_number) {
-			lret = dsdb_search_one(kdc_db_ctx->samdb, tmp_ctx,
-					       &msg, kdc_db_ctx->krbtgt_dn, LDB_SCOPE_BASE,
-					       krbtgt_attrs, DSDB_SEARCH_NO_GLOBAL_CATALOG | DSDB_SEARCH_UPDATE_MANAGED_PASSWORDS,
-					       "(objectClass=user)");
+			uint64_t seq_num = 0;
+			bool seq_valid = false;
+			bool cached;
+
+			cached = samba_kdc_msg_cache_fetch(kdc_db_ctx, tmp_ctx,
+							   "krbtgt",
+							   &seq_num, &seq_valid,
+							   NULL, &msg);
+			if (cached) {
+				lret = LDB_SUCCESS;
+			} else {
+				lret = dsdb_search_one(kdc_db_ctx->samdb, tmp_ctx,
+						       &msg, kdc_db_ctx->krbtgt_dn, LDB_SCOPE_BASE,
+						       krbtgt_attrs, DSDB_SEARCH_NO_GLOBAL_CATALOG | DSDB_SEARCH_UPDATE_MANAGED_PASSWORDS,
+						       "(objectClass=user)");
+				if (lret == LDB_SUCCESS) {
+					samba_kdc_msg_cache_store(kdc_db_ctx,
+								  "krbtgt",
+								  seq_num,
+								  seq_valid,
+								  NULL, msg);
+				}
+			}
 		} else {
 			/* We need to look up an RODC krbtgt (perhaps
 			 * ours, if we are an RODC, perhaps another
@@ -3180,6 +3385,9 @@ static krb5_error_code samba_kdc_lookup_server(krb5_context context,
 		NTSTATUS nt_status;
 		struct ldb_dn *user_dn;
 		char *principal_string;
+		char *cache_key = NULL;
+		uint64_t seq_num = 0;
+		bool seq_valid = false;
 
 		ret = krb5_unparse_name_flags(context, principal,
 					      KRB5_PRINCIPAL_UNPARSE_NO_REALM,
@@ -3188,6 +3396,21 @@ static krb5_error_code samba_kdc_lookup_server(krb5_context context,
 			return ret;
 		}
 
+		cache_key = talloc_asprintf(mem_ctx, "spn:%s",
+					    principal_string);
+		if (cache_key == NULL) {
+			free(principal_string);
+			return ENOMEM;
+		}
+
+		if (samba_kdc_msg_cache_fetch(kdc_db_ctx, mem_ctx, cache_key,
+					      &seq_num, &seq_valid,
+					      realm_dn, msg)) {
+			free(principal_string);
+			TALLOC_FREE(cache_key);
+			return 0;
+		}
+
 		/* At this point we may find the host is known to be
 		 * in a different realm, so we should generate a
 		 * referral instead */
@@ -3197,6 +3420,7 @@ static krb5_error_code samba_kdc_lookup_server(krb5_context context,
 		free(principal_string);
 
 		if (!NT_STATUS_IS_OK(nt_status)) {
+			TALLOC_FREE(cache_key);
 			return SDB_ERR_NOENTRY;
 		}
 
@@ -3207,8 +3431,14 @@ static krb5_error_code samba_kdc_lookup_server(krb5_context context,
 					  DSDB_SEARCH_SHOW_EXTENDED_DN | DSDB_SEARCH_NO_GLOBAL_CATALOG | DSDB_SEARCH_UPDATE_MANAGED_PASSWORDS,
 					  "(objectClass=*)");
 		if (ldb_ret != LDB_SUCCESS) {
+			TALLOC_FREE(cache_key);
 			return SDB_ERR_NOENTRY;
 		}
+
+		samba_kdc_msg_cache_store(kdc_db_ctx, cache_key,
+					  seq_num, seq_valid,
+					  *realm_dn, *msg);
+		TALLOC_FREE(cache_key);
 		return 0;
 	} else if (!(flags & SDB_F_FOR_AS_REQ)
 		   && smb_krb5_principal_get_type(context, principal) == KRB5_NT_ENTERPRISE_PRINCIPAL) {
@@ -3239,6 +3469,8 @@ static krb5_error_code samba_kdc_lookup_server(krb5_context context,
 		char *name1 = NULL;
 		size_t len1 = 0;
 		char *filter = NULL;
+		uint64_t seq_num = 0;
+		bool seq_valid = false;
 
 		if (smb_krb5_principal_get_type(context, principal) == KRB5_NT_ENTERPRISE_PRINCIPAL) {
 			char *str = NULL;
@@ -3306,6 +3538,12 @@ static krb5_error_code samba_kdc_lookup_server(krb5_context context,
 			}
 		}
 
+		if (samba_kdc_msg_cache_fetch(kdc_db_ctx, mem_ctx, filter,
+					      &seq_num, &seq_valid,
+					      NULL, msg)) {
+			return 0;
+		}
+
 		lret = dsdb_search_one(kdc_db_ctx->samdb, mem_ctx, msg,
 				       *realm_dn, LDB_SCOPE_SUBTREE,
 				       server_attrs,
@@ -3326,6 +3564,10 @@ static krb5_error_code samba_kdc_lookup_server(krb5_context context,
 				name1, ldb_errstring(kdc_db_ctx->samdb));
 			return SDB_ERR_NOENTRY;
 		}
+
+		samba_kdc_msg_cache_store(kdc_db_ctx, filter,
+					  seq_num, seq_valid,
+					  NULL, *msg);
 		return 0;
 	}
 	return SDB_ERR_NOENTRY;
@@ -4139,6 +4381,11 @@ NTSTATUS samba_kdc_setup_db_ctx(TALLOC_CTX *mem_ctx, struct samba_kdc_base_conte
 			talloc_free(kdc_db_ctx);
 			return NT_STATUS_CANT_ACCESS_DOMAIN_INFO;
 		}
+
+		kdc_db_ctx->msg_cache = samba_kdc_msg_cache_init(kdc_db_ctx,
+								 kdc_db_ctx->lp_ctx);
+		kdc_db_ctx->token_cache = samba_kdc_token_cache_init(kdc_db_ctx,
+								     kdc_db_ctx->lp_ctx);
 	}
 
 	/*
@@ -310,12 +310,28 @@ static NTSTATUS kdc_task_init(struct task_server *task)
 	kdc->task = task;
 	task->private_data = kdc;
 
-	/* start listening on the configured network interfaces */
-	status = kdc_startup_interfaces(kdc, task->lp_ctx, ifaces,
-					task->model_ops);
-	if (!NT_STATUS_IS_OK(status)) {
-		task_server_terminate(task, "kdc failed to setup interfaces", true);
-		return status;
+#ifdef SO_REUSEPORT
+	/*
+	 * With the prefork process model all workers share the
+	 * sockets of the master, and every worker is woken for each
+	 * UDP packet. With "kdc:reuseport = yes" every worker binds
+	 * its own SO_REUSEPORT sockets in kdc_post_fork() instead,
+	 * and the kernel spreads the requests over the workers.
+	 */
+	if (strcmp(task->model_ops->name, "prefork") == 0) {
+		kdc->reuseport = lpcfg_parm_bool(task->lp_ctx, NULL,
+						 "kdc", "reuseport", false);
+	}
+#endif
+
+	if (!kdc->reuseport) {
+		/* start listening on the configured network interfaces */
+		status = kdc_startup_interfaces(kdc, task->lp_ctx, ifaces,
+						task->model_ops);
+		if (!NT_STATUS_IS_OK(status)) {
+			task_server_terminate(task, "kdc failed to setup interfaces", true);
+			return status;
+		}
 	}
 
 
@@ -531,6 +547,22 @@ static void kdc_post_fork(struct task_server *task, struct process_details *pd)
 		return;
 	}
 
+	if (kdc->reuseport) {
+		struct interface *ifaces = NULL;
+
+		load_interface_list(task, task->lp_ctx, &ifaces);
+
+		status = kdc_startup_interfaces(kdc, task->lp_ctx, ifaces,
+						task->model_ops);
+		if (!NT_STATUS_IS_OK(status)) {
+			task_server_terminate(task,
+					      "kdc failed to setup "
+					      "SO_REUSEPORT interfaces",
+					      true);
+			return;
+		}
+	}
+
 	irpc_add_name(task->msg_ctx, "kdc_server");
 }
 
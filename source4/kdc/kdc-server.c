@@ -558,6 +558,7 @@ NTSTATUS kdc_add_socket(struct kdc_server *kdc,
 	struct kdc_socket *kdc_socket;
 	struct kdc_udp_socket *kdc_udp_socket;
 	struct tevent_req *udpsubreq;
+	const char *socket_options = lpcfg_socket_options(kdc->task->lp_ctx);
 	NTSTATUS status;
 	int ret;
 
@@ -575,6 +576,15 @@ NTSTATUS kdc_add_socket(struct kdc_server *kdc,
 		return status;
 	}
 
+#ifdef SO_REUSEPORT
+	if (kdc->reuseport) {
+		socket_options = talloc_asprintf(kdc_socket,
+						 "%s SO_REUSEPORT=1",
+						 socket_options);
+		NT_STATUS_HAVE_NO_MEMORY(socket_options);
+	}
+#endif
+
 	if (!udp_only) {
 		status = stream_setup_socket(kdc->task,
 					     kdc->task->event_ctx,
@@ -582,7 +592,7 @@ NTSTATUS kdc_add_socket(struct kdc_server *kdc,
 					     model_ops,
 					     &kdc_tcp_stream_ops,
 					     "ip", address, &port,
-					     lpcfg_socket_options(kdc->task->lp_ctx),
+					     socket_options,
 					     kdc_socket,
 					     kdc->task->process_context);
 		if (!NT_STATUS_IS_OK(status)) {
@@ -598,10 +608,25 @@ NTSTATUS kdc_add_socket(struct kdc_server *kdc,
 
 	kdc_udp_socket->kdc_socket = kdc_socket;
 
-	ret = tdgram_inet_udp_socket(kdc_socket->local_address,
-				     NULL,
-				     kdc_udp_socket,
-				     &kdc_udp_socket->dgram);
+#ifdef SO_REUSEPORT
+	if (kdc->reuseport) {
+		/*
+		 * Every prefork worker binds its own socket on the
+		 * same address and the kernel spreads the incoming
+		 * packets over them
+		 */
+		ret = dgram_setup_socket(kdc_udp_socket,
+					 kdc_socket->local_address,
+					 "SO_REUSEPORT=1",
+					 &kdc_udp_socket->dgram);
+	} else
+#endif
+	{
+		ret = tdgram_inet_udp_socket(kdc_socket->local_address,
+					     NULL,
+					     kdc_udp_socket,
+					     &kdc_udp_socket->dgram);
+	}
 	if (ret != 0) {
 		status = map_nt_error_from_unix_common(errno);
 		DBG_ERR("Failed to bind to %s:%u UDP - %s\n",
@@ -42,6 +42,12 @@ struct kdc_server {
 	const char *kpasswd_keytab_name;
 	void *private_data;
 	struct samba_kdc_db_context *kdc_db_ctx;
+
+	/*
+	 * Each prefork worker binds its own
+	 * SO_REUSEPORT UDP and TCP sockets
+	 */
+	bool reuseport;
 };
 
 typedef enum kdc_code_e {
@@ -25,6 +25,7 @@
 #include "lib/replace/system/kerberos.h"
 #include "lib/replace/system/filesys.h"
 #include "lib/util/debug.h"
+#include "lib/util/dlinklist.h"
 #include "lib/util/samba_util.h"
 #include "lib/util/talloc_stack.h"
 
@@ -1271,6 +1272,149 @@ NTSTATUS samba_kdc_get_claims_blob(TALLOC_CTX *mem_ctx,
 	return NT_STATUS_OK;
 }
 
+/*
+ * A small cache of the expanded group membership and claims of
+ * recently seen principals, keyed by objectSid. Building either means
+ * walking nested group memberships (or claim types) through sam.ldb,
+ * which dominates service ticket issuance for users in many groups.
+ *
+ * What authsam_make_user_info_dc() returns depends on the attributes
+ * that were loaded into the message (memberOf, displayName,
+ * logonCount...), and server and krbtgt entries are fetched with fewer
+ * attributes than clients. Whether the message carries the full set of
+ * client attributes is therefore part of the key.
+ *
+ * Entries are dropped as soon as the database sequence number moves,
+ * so any membership change invalidates the cache, and in any case
+ * after a few seconds, as some of the input (such as
+ * msDS-User-Account-Control-Computed) depends on the current time.
+ *
+ * The cached structures are shared with the samba_kdc_entry through
+ * talloc references and must be treated as read-only.
+ */
+struct samba_kdc_token_cache_entry {
+	struct samba_kdc_token_cache_entry *prev, *next;
+	struct dom_sid sid;
+	bool user_attrs_loaded;
+	uint64_t seq_num;
+	time_t expires;
+	const struct auth_user_info_dc *info;
+	struct claims_data *claims;
+	bool claims_are_initialized;
+};
+
+struct samba_kdc_token_cache {
+	struct samba_kdc_token_cache_entry *entries;
+	unsigned int num_entries;
+	unsigned int max_entries;
+	int ttl;
+};
+
+struct samba_kdc_token_cache *samba_kdc_token_cache_init(TALLOC_CTX *mem_ctx,
+							 struct loadparm_context *lp_ctx)
+{
+	struct samba_kdc_token_cache *cache = NULL;
+	int ttl;
+	int max_entries;
+
+	ttl = lpcfg_parm_int(lp_ctx, NULL, "kdc", "token cache ttl", 5);
+	max_entries = lpcfg_parm_int(lp_ctx, NULL, "kdc", "token cache size", 256);
+	if (ttl <= 0 || max_entries <= 0) {
+		return NULL;
+	}
+
+	cache = talloc_zero(mem_ctx, struct samba_kdc_token_cache);
+	if (cache == NULL) {
+		return NULL;
+	}
+	cache->ttl = ttl;
+	cache->max_entries = max_entries;
+
+	return cache;
+}
+
+/*
+ * Find the cache entry for the principal in msg, as loaded into entry,
+ * creating an empty one if there is none still valid. Returns NULL if
+ * the principal cannot be cached.
+ */
+static struct samba_kdc_token_cache_entry *samba_kdc_token_cache_get(
+	struct samba_kdc_db_context *kdc_db_ctx,
+	const struct samba_kdc_entry *entry,
+	const struct ldb_message *msg)
+{
+	struct samba_kdc_token_cache *cache = NULL;
+	struct samba_kdc_token_cache_entry *e = NULL;
+	struct dom_sid sid;
+	uint64_t seq_num;
+	time_t now;
+	int ret;
+
+	if (kdc_db_ctx == NULL || entry == NULL || msg == NULL) {
+		return NULL;
+	}
+
+	cache = kdc_db_ctx->token_cache;
+	if (cache == NULL) {
+		return NULL;
+	}
+
+	ret = samdb_result_dom_sid_buf(msg, "objectSid", &sid);
+	if (ret != LDB_SUCCESS) {
+		return NULL;
+	}
+
+	ret = ldb_sequence_number(kdc_db_ctx->samdb, LDB_SEQ_HIGHEST_SEQ,
+				  &seq_num);
+	if (ret != LDB_SUCCESS) {
+		return NULL;
+	}
+
+	now = time(NULL);
+
+	for (e = cache->entries; e != NULL; e = e->next) {
+		if (e->user_attrs_loaded == entry->user_attrs_loaded &&
+		    dom_sid_equal(&e->sid, &sid))
+		{
+			break;
+		}
+	}
+
+	if (e != NULL) {
+		if (e->seq_num == seq_num && e->expires >= now) {
+			DLIST_PROMOTE(cache->entries, e);
+			return e;
+		}
+
+		DLIST_REMOVE(cache->entries, e);
+		cache->num_entries--;
+		TALLOC_FREE(e);
+	}
+
+	e = talloc_zero(cache, struct samba_kdc_token_cache_entry);
+	if (e == NULL) {
+		return NULL;
+	}
+	e->sid = sid;
+	e->user_attrs_loaded = entry->user_attrs_loaded;
+	e->seq_num = seq_num;
+	e->expires = now + cache->ttl;
+
+	DLIST_ADD(cache->entries, e);
+	cache->num_entries++;
+
+	while (cache->num_entries > cache->max_entries) {
+		struct samba_kdc_token_cache_entry *last =
+			DLIST_TAIL(cache->entries);
+
+		DLIST_REMOVE(cache->entries, last);
+		cache->num_entries--;
+		TALLOC_FREE(last);
+	}
+
+	return e;
+}
+
 krb5_error_code samba_kdc_get_user_info_from_db(TALLOC_CTX *mem_ctx,
 						struct samba_kdc_db_context *kdc_db_ctx,
 						struct samba_kdc_entry *entry,
@@ -1298,9 +1442,21 @@ krb5_error_code samba_kdc_get_user_info_from_db(TALLOC_CTX *mem_ctx,
 	*info_out = NULL;
 
 	if (entry->info_from_db == NULL) {
+		struct samba_kdc_token_cache_entry *cached = NULL;
 		struct auth_user_info_dc *info_from_db = NULL;
 		struct loadparm_context *lp_ctx = kdc_db_ctx->lp_ctx;
 
+		cached = samba_kdc_token_cache_get(kdc_db_ctx, entry, msg);
+		if (cached != NULL && cached->info != NULL) {
+			nt_status = authsam_shallow_copy_user_info_dc(
+				entry, cached->info, &info_from_db);
+			if (NT_STATUS_IS_OK(nt_status)) {
+				entry->info_from_db = info_from_db;
+				*info_out = entry->info_from_db;
+				return 0;
+			}
+		}
+
 		nt_status = authsam_make_user_info_dc(entry,
 						      kdc_db_ctx->samdb,
 						      lpcfg_netbios_name(lp_ctx),
@@ -1318,6 +1474,16 @@ krb5_error_code samba_kdc_get_user_info_from_db(TALLOC_CTX *mem_ctx,
 			return map_errno_from_nt_status(nt_status);
 		}
 
+		if (cached != NULL && cached->info == NULL) {
+			struct auth_user_info_dc *info_cached = NULL;
+
+			nt_status = authsam_shallow_copy_user_info_dc(
+				cached, info_from_db, &info_cached);
+			if (NT_STATUS_IS_OK(nt_status)) {
+				cached->info = info_cached;
+			}
+		}
+
 		entry->info_from_db = info_from_db;
 	}
 
@@ -3501,6 +3667,7 @@ krb5_error_code samba_kdc_get_claims_data_from_db(struct ldb_context *samdb,
 {
 	TALLOC_CTX *frame = NULL;
 
+	struct samba_kdc_token_cache_entry *cached = NULL;
 	struct claims_data *claims_data = NULL;
 	struct CLAIMS_SET *claims_set = NULL;
 	NTSTATUS status = NT_STATUS_OK;
@@ -3529,6 +3696,23 @@ krb5_error_code samba_kdc_get_claims_data_from_db(struct ldb_context *samdb,
 		return 0;
 	}
 
+	cached = samba_kdc_token_cache_get(entry->kdc_db_ctx,
+					   entry,
+					   entry->msg);
+	if (cached != NULL && cached->claims_are_initialized) {
+		if (cached->claims != NULL &&
+		    talloc_reference(entry, cached->claims) == NULL)
+		{
+			return ENOMEM;
+		}
+		entry->claims_from_db = cached->claims;
+		entry->claims_from_db_are_initialized = true;
+
+		/* Note: the caller does not own this! */
+		*claims_data_out = entry->claims_from_db;
+		return 0;
+	}
+
 	frame = talloc_stackframe();
 
 	code = get_claims_set_for_principal(samdb,
@@ -3554,6 +3738,15 @@ krb5_error_code samba_kdc_get_claims_data_from_db(struct ldb_context *samdb,
 					     claims_data);
 	entry->claims_from_db_are_initialized = true;
 
+	if (cached != NULL) {
+		if (claims_data == NULL ||
+		    talloc_reference(cached, claims_data) != NULL)
+		{
+			cached->claims = claims_data;
+			cached->claims_are_initialized = true;
+		}
+	}
+
 	/* Note: the caller does not own this! */
 	*claims_data_out = entry->claims_from_db;
 
@@ -72,6 +72,9 @@ krb5_error_code samba_krbtgt_is_in_db(const struct samba_kdc_entry *skdc_entry,
 				      bool *is_in_db,
 				      bool *is_trusted);
 
+struct samba_kdc_token_cache *samba_kdc_token_cache_init(TALLOC_CTX *mem_ctx,
+							 struct loadparm_context *lp_ctx);
+
 krb5_error_code samba_kdc_get_user_info_from_db(TALLOC_CTX *mem_ctx,
 						struct samba_kdc_db_context *kdc_db_ctx,
 						struct samba_kdc_entry *entry,
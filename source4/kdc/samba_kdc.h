@@ -49,6 +49,8 @@ struct samba_kdc_base_context {
 };
 
 struct samba_kdc_seq;
+struct samba_kdc_msg_cache;
+struct samba_kdc_token_cache;
 
 struct samba_kdc_db_context {
 	struct tevent_context *ev_ctx;
@@ -56,6 +58,8 @@ struct samba_kdc_db_context {
 	struct imessaging_context *msg_ctx;
 	struct ldb_context *samdb;
 	struct samba_kdc_seq *seq_ctx;
+	struct samba_kdc_msg_cache *msg_cache;
+	struct samba_kdc_token_cache *token_cache;
 	bool rodc;
 	unsigned int my_krbtgt_number;
 	struct ldb_dn *krbtgt_dn;
@@ -87,6 +91,7 @@ struct samba_kdc_entry {
 	bool claims_from_pac_are_initialized : 1;
 	bool claims_from_db_are_initialized : 1;
 	bool group_managed_service_account : 1;
+	bool user_attrs_loaded : 1;
 	NTTIME current_nttime;
 	int64_t enforced_tgt_lifetime_nt_ticks;
 };
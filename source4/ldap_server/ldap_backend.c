@@ -323,6 +323,77 @@ static NTSTATUS ldapsrv_queue_reply_forced(struct ldapsrv_call *call,
 	return status;
 }
 
+/*
+ * Append an encoded reply to the batch buffer at the end of the
+ * reply queue, starting a new batch if needed.
+ *
+ * Large search results consist of many small entries, packing
+ * them avoids a talloc chunk and an iovec per entry and lets a
+ * single writev() send a lot more of them than IOV_MAX.
+ *
+ * A new batch is just the encoded reply itself, the buffer only
+ * grows (geometrically, up to LDAP_SERVER_REPLY_BATCH_SIZE) once
+ * further replies follow, so a lone bind or modify response
+ * costs no more memory than before.
+ */
+static NTSTATUS ldapsrv_queue_reply_batched(struct ldapsrv_call *call,
+					    struct ldapsrv_reply *reply)
+{
+	struct ldapsrv_reply *last = DLIST_TAIL(call->replies);
+	size_t needed;
+
+	if (reply->blob.length > LDAP_SERVER_REPLY_BATCH_SIZE / 2) {
+		/*
+		 * Not worth copying
+		 */
+		DLIST_ADD_END(call->replies, reply);
+		return NT_STATUS_OK;
+	}
+
+	/*
+	 * Replies queued unbatched (large ones and the forced ones)
+	 * have no batch_capacity, never append to them.
+	 */
+	if (last == NULL ||
+	    last->batch_capacity == 0 ||
+	    reply->blob.length > LDAP_SERVER_REPLY_BATCH_SIZE - last->blob.length)
+	{
+		reply->batch_capacity = reply->blob.length;
+		DLIST_ADD_END(call->replies, reply);
+		return NT_STATUS_OK;
+	}
+
+	needed = last->blob.length + reply->blob.length;
+	if (needed > last->batch_capacity) {
+		size_t capacity = MAX(last->batch_capacity * 2, needed);
+		uint8_t *batch = NULL;
+
+		capacity = MIN(capacity, LDAP_SERVER_REPLY_BATCH_SIZE);
+
+		batch = talloc_realloc(call,
+				       last->blob.data,
+				       uint8_t,
+				       capacity);
+		if (batch == NULL) {
+			TALLOC_FREE(reply->blob.data);
+			return NT_STATUS_NO_MEMORY;
+		}
+		talloc_set_name_const(batch, "Outgoing, encoded LDAP replies");
+
+		last->blob.data = batch;
+		last->batch_capacity = capacity;
+	}
+
+	memcpy(last->blob.data + last->blob.length,
+	       reply->blob.data,
+	       reply->blob.length);
+	last->blob.length = needed;
+
+	TALLOC_FREE(reply->blob.data);
+	TALLOC_FREE(reply);
+	return NT_STATUS_OK;
+}
+
 /*
  * Queue a reply (encoding it also) but check we do not send more than
  * LDAP_SERVER_MAX_REPLY_SIZE of responses as a way to limit the
@@ -347,9 +418,7 @@ NTSTATUS ldapsrv_queue_reply(struct ldapsrv_call *call, struct ldapsrv_reply *re
 
 	call->reply_size += reply->blob.length;
 
-	DLIST_ADD_END(call->replies, reply);
-
-	return status;
+	return ldapsrv_queue_reply_batched(call, reply);
 }
 
 static NTSTATUS ldapsrv_unwilling(struct ldapsrv_call *call, int error)
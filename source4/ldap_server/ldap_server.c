@@ -1216,7 +1216,9 @@ static const struct stream_server_ops ldapi_stream_priv_ops = {
 static NTSTATUS add_socket(struct task_server *task,
 			   struct loadparm_context *lp_ctx,
 			   const struct model_ops *model_ops,
-			   const char *address, struct ldapsrv_service *ldap_service)
+			   const char *address,
+			   const char *socket_options,
+			   struct ldapsrv_service *ldap_service)
 {
 	uint16_t port = 389;
 	NTSTATUS status;
@@ -1225,7 +1227,7 @@ static NTSTATUS add_socket(struct task_server *task,
 	status = stream_setup_socket(task, task->event_ctx, lp_ctx,
 				     model_ops, &ldap_stream_nonpriv_ops,
 				     "ip", address, &port,
-				     lpcfg_socket_options(lp_ctx),
+				     socket_options,
 				     ldap_service, task->process_context);
 	if (!NT_STATUS_IS_OK(status)) {
 		DBG_ERR("ldapsrv failed to bind to %s:%u - %s\n",
@@ -1240,7 +1242,7 @@ static NTSTATUS add_socket(struct task_server *task,
 					     model_ops,
 					     &ldap_stream_nonpriv_ops,
 					     "ip", address, &port,
-					     lpcfg_socket_options(lp_ctx),
+					     socket_options,
 					     ldap_service,
 					     task->process_context);
 		if (!NT_STATUS_IS_OK(status)) {
@@ -1267,7 +1269,7 @@ static NTSTATUS add_socket(struct task_server *task,
 					     model_ops,
 					     &ldap_stream_nonpriv_ops,
 					     "ip", address, &port,
-					     lpcfg_socket_options(lp_ctx),
+					     socket_options,
 					     ldap_service,
 					     task->process_context);
 		if (!NT_STATUS_IS_OK(status)) {
@@ -1282,7 +1284,7 @@ static NTSTATUS add_socket(struct task_server *task,
 						     model_ops,
 						     &ldap_stream_nonpriv_ops,
 						     "ip", address, &port,
-						     lpcfg_socket_options(lp_ctx),
+						     socket_options,
 						     ldap_service,
 						     task->process_context);
 			if (!NT_STATUS_IS_OK(status)) {
@@ -1403,6 +1405,59 @@ static void ldap_reload_certs(struct imessaging_context *msg_ctx,
 /*
   open the ldap server sockets
 */
+static NTSTATUS ldapsrv_add_ip_sockets(struct task_server *task,
+				       const char *socket_options,
+				       struct ldapsrv_service *ldap_service)
+{
+	NTSTATUS status;
+
+	if (lpcfg_interfaces(task->lp_ctx) && lpcfg_bind_interfaces_only(task->lp_ctx)) {
+		struct interface *ifaces;
+		int num_interfaces;
+		int i;
+
+		load_interface_list(task, task->lp_ctx, &ifaces);
+		num_interfaces = iface_list_count(ifaces);
+
+		/* We have been given an interfaces line, and been
+		   told to only bind to those interfaces. Create a
+		   socket per interface and bind to only these.
+		*/
+		for(i = 0; i < num_interfaces; i++) {
+			const char *address = iface_list_n_ip(ifaces, i);
+			status = add_socket(task, task->lp_ctx, task->model_ops,
+					    address, socket_options,
+					    ldap_service);
+			if (!NT_STATUS_IS_OK(status)) {
+				return status;
+			}
+		}
+	} else {
+		char **wcard;
+		size_t i;
+		size_t num_binds = 0;
+		wcard = iface_list_wildcard(task);
+		if (wcard == NULL) {
+			DBG_ERR("No wildcard addresses available\n");
+			return NT_STATUS_UNSUCCESSFUL;
+		}
+		for (i=0; wcard[i]; i++) {
+			status = add_socket(task, task->lp_ctx, task->model_ops,
+					    wcard[i], socket_options,
+					    ldap_service);
+			if (NT_STATUS_IS_OK(status)) {
+				num_binds++;
+			}
+		}
+		talloc_free(wcard);
+		if (num_binds == 0) {
+			return NT_STATUS_UNSUCCESSFUL;
+		}
+	}
+
+	return NT_STATUS_OK;
+}
+
 static NTSTATUS ldapsrv_task_init(struct task_server *task)
 {
 	char *ldapi_path;
@@ -1470,44 +1525,30 @@ static NTSTATUS ldapsrv_task_init(struct task_server *task)
 		goto failed;
 	}
 
-	if (lpcfg_interfaces(task->lp_ctx) && lpcfg_bind_interfaces_only(task->lp_ctx)) {
-		struct interface *ifaces;
-		int num_interfaces;
-		int i;
-
-		load_interface_list(task, task->lp_ctx, &ifaces);
-		num_interfaces = iface_list_count(ifaces);
+#ifdef SO_REUSEPORT
+	/*
+	 * With the prefork process model all workers
+	 * inherit the listening sockets of the master and
+	 * race for every new connection. With
+	 * "ldap server:reuseport = yes" every worker binds
+	 * its own SO_REUSEPORT socket in ldapsrv_post_fork()
+	 * instead and the kernel spreads the connections
+	 * evenly over the workers.
+	 */
+	if (strcmp(task->model_ops->name, "prefork") == 0) {
+		ldap_service->reuseport = lpcfg_parm_bool(task->lp_ctx,
+							  NULL,
+							  "ldap server",
+							  "reuseport",
+							  false);
+	}
+#endif
 
-		/* We have been given an interfaces line, and been
-		   told to only bind to those interfaces. Create a
-		   socket per interface and bind to only these.
-		*/
-		for(i = 0; i < num_interfaces; i++) {
-			const char *address = iface_list_n_ip(ifaces, i);
-			status = add_socket(task, task->lp_ctx, task->model_ops,
-					    address, ldap_service);
-			if (!NT_STATUS_IS_OK(status)) goto failed;
-		}
-	} else {
-		char **wcard;
-		size_t i;
-		size_t num_binds = 0;
-		wcard = iface_list_wildcard(task);
-		if (wcard == NULL) {
-			DBG_ERR("No wildcard addresses available\n");
-			status = NT_STATUS_UNSUCCESSFUL;
-			goto failed;
-		}
-		for (i=0; wcard[i]; i++) {
-			status = add_socket(task, task->lp_ctx, task->model_ops,
-					    wcard[i], ldap_service);
-			if (NT_STATUS_IS_OK(status)) {
-				num_binds++;
-			}
-		}
-		talloc_free(wcard);
-		if (num_binds == 0) {
-			status = NT_STATUS_UNSUCCESSFUL;
+	if (!ldap_service->reuseport) {
+		status = ldapsrv_add_ip_sockets(task,
+						lpcfg_socket_options(task->lp_ctx),
+						ldap_service);
+		if (!NT_STATUS_IS_OK(status)) {
 			goto failed;
 		}
 	}
@@ -1605,6 +1646,30 @@ static void ldapsrv_post_fork(struct task_server *task, struct process_details *
 				      true);
 		return;
 	}
+
+	if (ldap_service->reuseport) {
+		const char *socket_options = NULL;
+		NTSTATUS status;
+
+		socket_options = talloc_asprintf(ldap_service,
+						 "%s SO_REUSEPORT=1",
+						 lpcfg_socket_options(task->lp_ctx));
+		if (socket_options == NULL) {
+			task_server_terminate(task, "Out of memory", true);
+			return;
+		}
+
+		status = ldapsrv_add_ip_sockets(task,
+						socket_options,
+						ldap_service);
+		if (!NT_STATUS_IS_OK(status)) {
+			task_server_terminate(task,
+					      "Cannot bind SO_REUSEPORT "
+					      "ldap sockets",
+					      true);
+			return;
+		}
+	}
 }
 
 static void ldapsrv_before_loop(struct task_server *task)
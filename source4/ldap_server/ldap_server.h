@@ -80,6 +80,13 @@ struct ldapsrv_call {
 		struct ldapsrv_reply *prev, *next;
 		struct ldap_message *msg;
 		DATA_BLOB blob;
+		/*
+		 * If not 0, blob.data is a buffer of this size
+		 * holding one or more encoded replies back to
+		 * back, more can be appended to it, see
+		 * ldapsrv_queue_reply().
+		 */
+		size_t batch_capacity;
 	} *replies;
 	struct iovec *out_iov;
 	size_t iov_count;
@@ -114,6 +121,12 @@ struct ldapsrv_call {
  */
 #define LDAP_SERVER_MAX_CHUNK_SIZE ((size_t)(25 * 1024 * 1024))
 
+/*
+ * Small encoded replies are packed into buffers of up to
+ * this size, so that each writev() sends many of them
+ */
+#define LDAP_SERVER_REPLY_BATCH_SIZE ((size_t)(64 * 1024))
+
 struct ldapsrv_service {
 	const char *dns_host_name;
 	pid_t parent_pid;
@@ -129,6 +142,12 @@ struct ldapsrv_service {
 	struct tevent_context *current_ev;
 	struct imessaging_context *current_msg;
 	struct ldb_context *sam_ctx;
+
+	/*
+	 * Each prefork worker binds its own
+	 * SO_REUSEPORT listening sockets
+	 */
+	bool reuseport;
 };
 
 #include "ldap_server/proto.h"
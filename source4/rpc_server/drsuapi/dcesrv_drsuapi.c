@@ -168,6 +168,31 @@ static WERROR dcesrv_drsuapi_DsBind(struct dcesrv_call_state *dce_call, TALLOC_C
 	 */
 	if (r->in.bind_info) {
 		b_state->remote_info = r->in.bind_info;
+
+		switch (r->in.bind_info->length) {
+		case 24:
+			b_state->remote_extensions =
+				r->in.bind_info->info.info24.supported_extensions;
+			break;
+		case 28:
+			b_state->remote_extensions =
+				r->in.bind_info->info.info28.supported_extensions;
+			break;
+		case 32:
+			b_state->remote_extensions =
+				r->in.bind_info->info.info32.supported_extensions;
+			break;
+		case 48:
+			b_state->remote_extensions =
+				r->in.bind_info->info.info48.supported_extensions;
+			break;
+		case 52:
+			b_state->remote_extensions =
+				r->in.bind_info->info.info52.supported_extensions;
+			break;
+		default:
+			break;
+		}
 	}
 
 	/*
@@ -184,9 +209,14 @@ static WERROR dcesrv_drsuapi_DsBind(struct dcesrv_call_state *dce_call, TALLOC_C
 	supported_extensions |= DRSUAPI_SUPPORTED_EXTENSION_ASYNC_REPLICATION;
 	supported_extensions |= DRSUAPI_SUPPORTED_EXTENSION_REMOVEAPI;
 	supported_extensions |= DRSUAPI_SUPPORTED_EXTENSION_MOVEREQ_V2;
-#if 0 /* we don't support MSZIP compression (only decompression) */
-	supported_extensions |= DRSUAPI_SUPPORTED_EXTENSION_GETCHG_COMPRESS;
-#endif
+	/*
+	 * MSZIP compressed GetNCChanges replies are optional, as
+	 * they trade DC CPU time for bandwidth
+	 */
+	if (lpcfg_parm_bool(dce_call->conn->dce_ctx->lp_ctx, NULL,
+			    "drs", "compress replies", false)) {
+		supported_extensions |= DRSUAPI_SUPPORTED_EXTENSION_GETCHG_COMPRESS;
+	}
 	supported_extensions |= DRSUAPI_SUPPORTED_EXTENSION_DCINFO_V1;
 	supported_extensions |= DRSUAPI_SUPPORTED_EXTENSION_RESTORE_USN_OPTIMIZATION;
 	supported_extensions |= DRSUAPI_SUPPORTED_EXTENSION_KCC_EXECUTE;
@@ -211,7 +241,7 @@ static WERROR dcesrv_drsuapi_DsBind(struct dcesrv_call_state *dce_call, TALLOC_C
 	supported_extensions |= DRSUAPI_SUPPORTED_EXTENSION_ADDENTRYREPLY_V3;
 	supported_extensions |= DRSUAPI_SUPPORTED_EXTENSION_GETCHGREPLY_V7;
 	supported_extensions |= DRSUAPI_SUPPORTED_EXTENSION_VERIFY_OBJECT;
-#if 0 /* we don't support XPRESS compression yet */
+#if 0 /* we don't support XPRESS (WIN2K3_LZ77_DIRECT2) compression yet */
 	supported_extensions |= DRSUAPI_SUPPORTED_EXTENSION_XPRESS_COMPRESS;
 #endif
 	supported_extensions |= DRSUAPI_SUPPORTED_EXTENSION_GETCHGREQ_V10;
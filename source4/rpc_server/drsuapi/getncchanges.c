@@ -2696,6 +2696,52 @@ static struct getncchanges_repl_chunk * getncchanges_chunk_new(TALLOC_CTX *mem_c
 	return repl_chunk;
 }
 
+/*
+ * Convert the ctr6 reply into a level 7 MSZIP compressed reply, if
+ * the client asked for compression, advertised support for it at
+ * DsBind time and we have it enabled.  The compression itself is
+ * done by the NDR layer when the reply is marshalled.
+ */
+static WERROR getncchanges_compress_reply(struct dcesrv_call_state *dce_call,
+					  struct drsuapi_bind_state *b_state,
+					  struct drsuapi_DsGetNCChangesRequest10 *req10,
+					  TALLOC_CTX *mem_ctx,
+					  struct drsuapi_DsGetNCChanges *r)
+{
+	struct drsuapi_DsGetNCChangesCtr6TS *ts = NULL;
+
+	if (*r->out.level_out != 6) {
+		return WERR_OK;
+	}
+
+	if (!(req10->replica_flags & DRSUAPI_DRS_USE_COMPRESSION)) {
+		return WERR_OK;
+	}
+
+	if (!(b_state->remote_extensions & DRSUAPI_SUPPORTED_EXTENSION_GETCHG_COMPRESS)) {
+		return WERR_OK;
+	}
+
+	if (!lpcfg_parm_bool(dce_call->conn->dce_ctx->lp_ctx, NULL,
+			     "drs", "compress replies", false)) {
+		return WERR_OK;
+	}
+
+	ts = talloc_zero(mem_ctx, struct drsuapi_DsGetNCChangesCtr6TS);
+	W_ERROR_HAVE_NO_MEMORY(ts);
+
+	/* ctr6 and ctr7 share the same union storage */
+	ts->ctr6 = r->out.ctr->ctr6;
+
+	ZERO_STRUCT(r->out.ctr->ctr7);
+	*r->out.level_out = 7;
+	r->out.ctr->ctr7.level = 6;
+	r->out.ctr->ctr7.type = DRSUAPI_COMPRESSION_TYPE_MSZIP;
+	r->out.ctr->ctr7.ctr.mszip6.ts = ts;
+
+	return WERR_OK;
+}
+
 /*
   drsuapi_DsGetNCChanges
 
@@ -3906,5 +3952,6 @@ allowed:
 	}
 #endif
 
-	return WERR_OK;
+	return getncchanges_compress_reply(dce_call, b_state, req10,
+					   mem_ctx, r);
 }
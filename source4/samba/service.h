@@ -106,6 +106,9 @@ struct service_details {
 
 NTSTATUS samba_service_init(void);
 
+struct tsocket_address;
+struct tdgram_context;
+
 #include "samba/service_proto.h"
 
 #endif /* __SERVICE_H__ */
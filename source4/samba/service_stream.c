@@ -403,9 +403,79 @@ NTSTATUS stream_setup_socket(TALLOC_CTX *mem_ctx,
 	return NT_STATUS_OK;
 }
 
+/*
+  create a UDP socket bound to the given address, socket_options
+  (e.g. "SO_REUSEPORT=1 SO_RCVBUF=1048576") are set before the bind
+*/
+int dgram_setup_socket(TALLOC_CTX *mem_ctx,
+		       const struct tsocket_address *local_address,
+		       const char *socket_options,
+		       struct tdgram_context **dgram)
+{
+	struct sockaddr_storage ss;
+	ssize_t sa_len;
+	int saved_errno;
+	int val = 1;
+	int fd;
+	int ret;
+
+	sa_len = tsocket_address_bsd_sockaddr(local_address,
+					      (struct sockaddr *)&ss,
+					      sizeof(ss));
+	if (sa_len < 0) {
+		return -1;
+	}
+
+	fd = socket(ss.ss_family, SOCK_DGRAM, 0);
+	if (fd < 0) {
+		return -1;
+	}
+
+	set_blocking(fd, false);
+	smb_set_close_on_exec(fd);
+
+#ifdef HAVE_IPV6
+	if (ss.ss_family == AF_INET6) {
+		ret = setsockopt(fd, IPPROTO_IPV6, IPV6_V6ONLY,
+				 (const void *)&val, sizeof(val));
+		if (ret == -1) {
+			goto fail;
+		}
+	}
+#endif
+
+	ret = setsockopt(fd, SOL_SOCKET, SO_REUSEADDR,
+			 (const void *)&val, sizeof(val));
+	if (ret == -1) {
+		goto fail;
+	}
+
+	if (socket_options != NULL) {
+		set_socket_options(fd, socket_options);
+	}
+
+	ret = bind(fd, (struct sockaddr *)&ss, sa_len);
+	if (ret == -1) {
+		goto fail;
+	}
+
+	ret = tdgram_bsd_existing_socket(mem_ctx, fd, dgram);
+	if (ret == -1) {
+		goto fail;
+	}
+
+	return 0;
+
+fail:
+	saved_errno = errno;
+	close(fd);
+	errno = saved_errno;
+	return -1;
+}
+
 
 /*
-  setup a connection title 
+  setup a connection title
 */
 void stream_connection_set_title(struct stream_connection *conn, const char *title)
 {
@@ -35,6 +35,7 @@ from ldb import SCOPE_BASE
 import random
 
 from samba.dcerpc import drsuapi, misc
+from samba.drs_utils import drs_DsBind
 from samba import WERRORError
 from samba import werror
 
@@ -1166,6 +1167,38 @@ class DrsReplicaSyncIntegrityTestCase(drs_base.DrsBaseTestCase):
         self.assert_expected_links([la_source], link_attr="addressBookRoots2",
                                    num_expected=500)
 
+    def test_repl_links_many_targets(self):
+        """
+        Applies groups of links with more targets than a single batched
+        target lookup covers, and checks the peer DC ends up with the
+        same links.
+        """
+        la_targets = self.create_object_range(0, 250, prefix="la_many_tgt")
+        la_sources = []
+        for x in range(0, 2):
+            la_source = "CN=la_many_src%d,%s" % (x, self.ou)
+            self.add_object(la_source,
+                            objectclass="msExchConfigurationContainer")
+            la_sources.append(la_source)
+
+        # the second source shares half of the first one's targets
+        self.modify_object(la_sources[0], "addressBookRoots2", la_targets)
+        self.modify_object(la_sources[1], "addressBookRoots2",
+                           la_targets[::2])
+
+        self.sync_DCs()
+
+        for la_source, num_expected in zip(la_sources, [250, 125]):
+            expected = self.ldb_dc2.search(base=la_source, scope=SCOPE_BASE,
+                                           attrs=["addressBookRoots2"])
+            actual = self.ldb_dc1.search(base=la_source, scope=SCOPE_BASE,
+                                         attrs=["addressBookRoots2"])
+            expected_links = sorted(str(v) for v in
+                                    expected[0]["addressBookRoots2"])
+            actual_links = sorted(str(v) for v in
+                                  actual[0]["addressBookRoots2"])
+            self.assertEqual(len(expected_links), num_expected)
+            self.assertEqual(actual_links, expected_links)
 
     def test_InvalidNC_DummyDN_InvalidGUID_full_repl(self):
         """Test full replication on a totally invalid GUID fails with the right error code"""
@@ -1465,6 +1498,96 @@ class DrsReplicaSyncFakeAzureAdTests(DrsReplicaSyncIntegrityTestCase):
         super().setUp()
 
 
+class DrsReplicaCompressionTestCase(drs_base.DrsBaseTestCase):
+    """Tests the MSZIP compressed replies of DC2, which are only sent
+    with "drs:compress replies = yes" (e.g. the vampire_dc)"""
+
+    def setUp(self):
+        super().setUp()
+
+        self.set_test_ldb_dc(self.ldb_dc2)
+
+        (_, _, extensions) = self._bind_dc2()
+        if not extensions & drsuapi.DRSUAPI_SUPPORTED_EXTENSION_GETCHG_COMPRESS:
+            self.skipTest("%s does not send compressed replies" %
+                          self.dnsname_dc2)
+
+    def _bind_dc2(self, exclude_extensions=0):
+        binding_str = "ncacn_ip_tcp:%s[seal]" % self.dnsname_dc2
+        drs = drsuapi.drsuapi(binding_str,
+                              self.get_loadparm(),
+                              self.get_credentials())
+        (drs_handle, extensions) = drs_DsBind(
+            drs, exclude_extensions=exclude_extensions)
+        return (drs, drs_handle, extensions)
+
+    def _get_changes(self, replica_flags, exclude_extensions=0):
+        """Returns the first objects of the domain NC, each request on a
+        new connection so it is not taken as the next chunk"""
+        (drs, drs_handle, _) = self._bind_dc2(
+            exclude_extensions=exclude_extensions)
+
+        req10 = self._getnc_req10(dest_dsa=None,
+                                  invocation_id=self.ldb_dc2.get_invocation_id(),
+                                  nc_dn_str=self.domain_dn,
+                                  exop=drsuapi.DRSUAPI_EXOP_NONE,
+                                  replica_flags=replica_flags,
+                                  max_objects=100)
+        return drs.DsGetNCChanges(drs_handle, 10, req10)
+
+    def _get_ctr6_attids(self, ctr6):
+        """Returns the attribute ids sent for each object, the values
+        of secret attributes are encrypted differently on each
+        connection"""
+        attids = []
+        obj = ctr6.first_object
+        for i in range(0, ctr6.object_count):
+            attr_ctr = obj.object.attribute_ctr
+            attids.append([attr_ctr.attributes[j].attid
+                           for j in range(0, attr_ctr.num_attributes)])
+            obj = obj.next_object
+        return attids
+
+    def test_compressed(self):
+        """A client asking for compression gets a level 7 MSZIP reply with
+        the same ctr6 as without compression"""
+        flags = drsuapi.DRSUAPI_DRS_WRIT_REP | drsuapi.DRSUAPI_DRS_GET_ANC
+
+        (level, ctr6) = self._get_changes(flags)
+        self.assertEqual(level, 6)
+        self.assertGreater(ctr6.object_count, 0)
+
+        (level, ctr) = self._get_changes(
+            flags | drsuapi.DRSUAPI_DRS_USE_COMPRESSION)
+        self.assertEqual(level, 7)
+        self.assertEqual(ctr.level, 6)
+        self.assertEqual(ctr.type, drsuapi.DRSUAPI_COMPRESSION_TYPE_MSZIP)
+        self.assertLess(ctr.ctr.compressed_length,
+                        ctr.ctr.decompressed_length)
+
+        # The high watermark follows any write on DC2, so only the
+        # objects are compared.
+        decompressed = ctr.ctr.ts.ctr6
+        self.assertEqual(decompressed.object_count, ctr6.object_count)
+        self.assertEqual(self._get_ctr6_object_guids(decompressed),
+                         self._get_ctr6_object_guids(ctr6))
+        self.assertEqual(self._get_ctr6_attids(decompressed),
+                         self._get_ctr6_attids(ctr6))
+
+    def test_no_client_support(self):
+        """A client that did not advertise GETCHG_COMPRESS at DsBind
+        time gets a plain ctr6, even if it asks for compression"""
+        flags = (drsuapi.DRSUAPI_DRS_WRIT_REP |
+                 drsuapi.DRSUAPI_DRS_GET_ANC |
+                 drsuapi.DRSUAPI_DRS_USE_COMPRESSION)
+
+        (level, ctr) = self._get_changes(
+            flags,
+            exclude_extensions=drsuapi.DRSUAPI_SUPPORTED_EXTENSION_GETCHG_COMPRESS)
+        self.assertEqual(level, 6)
+        self.assertGreater(ctr.object_count, 0)
+
+
 class DcConnection:
     """Helper class to track a connection to another DC"""
 